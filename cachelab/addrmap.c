@@ -0,0 +1,122 @@
+/*
+ * addrmap.c - Linear probing hash map with backward-shift deletion, so
+ *             lookups never have to skip over tombstones.
+ */
+#include "addrmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline size_t hashAddr(uint64_t key, size_t mask){
+    // Fibonacci hashing spreads strided block numbers over the table
+    return (size_t)((key * 0x9E3779B97F4A7C15UL) >> 17) & mask;
+}
+
+static bool allocSlots(addrmap_t *map, size_t capacity){
+    map->keys = malloc(capacity * sizeof(uint64_t));
+    map->vals = malloc(capacity * sizeof(uint64_t));
+    if(!map->keys || !map->vals) {
+        free(map->keys);
+        free(map->vals);
+        return false;
+    }
+    // All bits set is ADDRMAP_EMPTY
+    memset(map->keys, 0xff, capacity * sizeof(uint64_t));
+    map->capacity = capacity;
+    map->count = 0;
+    return true;
+}
+
+bool initAddrMap(addrmap_t *map, size_t capacity){
+    size_t size = 16;
+    while(size < capacity) {
+        size <<= 1;
+    }
+    return allocSlots(map, size);
+}
+
+void freeAddrMap(addrmap_t *map){
+    free(map->keys);
+    free(map->vals);
+    map->keys = map->vals = NULL;
+    map->capacity = map->count = 0;
+}
+
+void clearAddrMap(addrmap_t *map){
+    memset(map->keys, 0xff, map->capacity * sizeof(uint64_t));
+    map->count = 0;
+}
+
+uint64_t* addrMapFind(const addrmap_t *map, uint64_t key){
+    size_t mask = map->capacity - 1;
+    for(size_t i = hashAddr(key, mask); ; i = (i + 1) & mask) {
+        if(map->keys[i] == key) {
+            return map->vals + i;
+        }
+        if(map->keys[i] == ADDRMAP_EMPTY) {
+            return NULL;
+        }
+    }
+}
+
+static bool growAddrMap(addrmap_t *map){
+    addrmap_t old = *map;
+    if(!allocSlots(map, old.capacity << 1)) {
+        *map = old;
+        return false;
+    }
+    for(size_t i = 0; i < old.capacity; i++) {
+        if(old.keys[i] != ADDRMAP_EMPTY) {
+            addrMapInsert(map, old.keys[i], old.vals[i], NULL);
+        }
+    }
+    free(old.keys);
+    free(old.vals);
+    return true;
+}
+
+uint64_t* addrMapInsert(addrmap_t *map, uint64_t key, uint64_t val, bool *inserted){
+    // Keep the load factor under 3/4
+    if((map->count + 1) * 4 > map->capacity * 3 && !growAddrMap(map)) {
+        return NULL;
+    }
+    size_t mask = map->capacity - 1;
+    size_t i = hashAddr(key, mask);
+    for(; map->keys[i] != ADDRMAP_EMPTY; i = (i + 1) & mask) {
+        if(map->keys[i] == key) {
+            if(inserted) {
+                *inserted = false;
+            }
+            return map->vals + i;
+        }
+    }
+    map->keys[i] = key;
+    map->vals[i] = val;
+    map->count++;
+    if(inserted) {
+        *inserted = true;
+    }
+    return map->vals + i;
+}
+
+bool addrMapRemove(addrmap_t *map, uint64_t key){
+    size_t mask = map->capacity - 1;
+    size_t i = hashAddr(key, mask);
+    while(map->keys[i] != key) {
+        if(map->keys[i] == ADDRMAP_EMPTY) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+    // Shift back following entries whose probe sequence passes through i
+    for(size_t j = (i + 1) & mask; map->keys[j] != ADDRMAP_EMPTY; j = (j + 1) & mask) {
+        size_t home = hashAddr(map->keys[j], mask);
+        if(((j - home) & mask) >= ((j - i) & mask)) {
+            map->keys[i] = map->keys[j];
+            map->vals[i] = map->vals[j];
+            i = j;
+        }
+    }
+    map->keys[i] = ADDRMAP_EMPTY;
+    map->count--;
+    return true;
+}
@@ -0,0 +1,32 @@
+/*
+ * addrmap.h - Open-addressing hash map from 64-bit addresses (block or
+ *             page numbers) to 64-bit values
+ */
+#ifndef CSIM_ADDRMAP_H
+#define CSIM_ADDRMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Key value reserved to mark empty slots, never a valid block number
+#define ADDRMAP_EMPTY (~0UL)
+
+typedef struct addrmap{
+    uint64_t *keys;
+    uint64_t *vals;
+    size_t capacity; // Always a power of two
+    size_t count;
+}addrmap_t;
+
+bool initAddrMap(addrmap_t *map, size_t capacity);
+void freeAddrMap(addrmap_t *map);
+void clearAddrMap(addrmap_t *map);
+
+// Return a pointer to the value of key, or NULL if it is not present
+uint64_t* addrMapFind(const addrmap_t *map, uint64_t key);
+// Return the value slot of key, inserting val first if key is missing
+uint64_t* addrMapInsert(addrmap_t *map, uint64_t key, uint64_t val, bool *inserted);
+bool addrMapRemove(addrmap_t *map, uint64_t key);
+
+#endif /* CSIM_ADDRMAP_H */
@@ -0,0 +1,83 @@
+#!/bin/sh
+#
+# bench.sh - Throughput benchmark of csim over synthetic traces
+#
+# Generates traces with synthgen (once, into the bench/ scratch directory,
+# named after their generator parameters), runs csim --timing on each of
+# them for every cache geometry below and writes one line per trace and
+# geometry to bench/results.txt. Each cell is the best of BENCH_RUNS runs,
+# since single runs swing by 20% on a busy machine. Cells whose rate
+# dropped by more than BENCH_TOLERANCE percent below the saved
+# baseline, bench-baseline.txt (kept by make clean), are reported as
+# regressions and the script fails. "./bench.sh save" stores the results
+# as the new baseline.
+#
+MODE=$1
+DIR=bench
+BASELINE=${BENCH_BASELINE:-bench-baseline.txt}
+ACCESSES=${BENCH_ACCESSES:-1000000}
+RUNS=${BENCH_RUNS:-5}
+TOLERANCE=${BENCH_TOLERANCE:-10}
+GEOMETRIES="5,1,5 8,4,6 12,8,6 0,64,6 20,16,6"
+TRACES="seq stride random zipf chase mixed"
+
+# Generator options of each trace
+options() {
+    case $1 in
+    seq)    echo "-p seq -f 67108864" ;;
+    stride) echo "-p stride -f 67108864 -s 4160" ;;
+    random) echo "-p random -f 16777216" ;;
+    zipf)   echo "-p zipf -f 16777216 -z 0.9" ;;
+    chase)  echo "-p chase -f 4194304 -k 64" ;;
+    mixed)  echo "-p random -f 1048576 -w 0.3" ;;
+    esac
+}
+
+# Trace file of a name, changing with any generator parameter
+path() {
+    echo "$DIR/$1-n$ACCESSES$(options $1 | tr -d ' ').trace"
+}
+
+mkdir -p $DIR
+for t in $TRACES; do
+    if [ ! -f "$(path $t)" ]; then
+        ./synthgen -n $ACCESSES $(options $t) > "$(path $t).tmp" && mv "$(path $t).tmp" "$(path $t)"
+    fi
+done
+
+printf "%-8s %-9s %12s %9s %9s %10s\n" trace s,E,b records/s parse simulate peak-rss > $DIR/results.txt
+for t in $TRACES; do
+    for g in $GEOMETRIES; do
+        echo $g | tr , ' ' | { read s E b
+        run=0
+        while [ $run -lt $RUNS ]; do
+            ./csim -s $s -E $E -b $b -t "$(path $t)" --timing 2>&1 >/dev/null | \
+                sed -n 's/^timing: records:[0-9]* parse:\([0-9.]*\)s simulate:\([0-9.]*\)s rate:\([0-9]*\)\/s peak-rss:\([0-9]*\)KB/\3 \1 \2 \4/p'
+            run=$((run + 1))
+        done | sort -n -r | head -1 | while read rate parse simulate rss; do
+            printf "%-8s %-9s %12s %8ss %8ss %8sKB\n" $t $g $rate $parse $simulate $rss
+        done >> $DIR/results.txt; }
+    done
+done
+cat $DIR/results.txt
+
+if [ "$MODE" = save ]; then
+    cp $DIR/results.txt $BASELINE
+    echo "Saved $BASELINE"
+    exit 0
+fi
+if [ ! -f $BASELINE ]; then
+    echo "No baseline $BASELINE to compare against, run make bench-baseline"
+    exit 1
+fi
+awk -v tol=$TOLERANCE '
+    NR == FNR { if (FNR > 1) base[$1 " " $2] = $3; next }
+    FNR > 1 && ($1 " " $2) in base {
+        change = 100 * ($3 - base[$1 " " $2]) / base[$1 " " $2]
+        if (change < -tol) {
+            printf "REGRESSION %s %s: %d/s vs baseline %d/s (%.1f%%)\n", $1, $2, $3, base[$1 " " $2], change
+            bad = 1
+        }
+    }
+    END { if (bad) exit 1; print "No regression beyond " tol "% against the baseline" }
+' $BASELINE $DIR/results.txt
@@ -0,0 +1,366 @@
+/*
+ * cache.c - Set-associative LRU cache model
+ *
+ * Every set keeps its lines in a list ordered by use time, the least
+ * recently used line at the front and the most recently used at the back.
+ *
+ * Geometry is 64-bit throughout. Caches with more than DENSE_SET_LIMIT
+ * sets are sparse: a set is allocated the first time an access maps to
+ * it, so memory grows with the sets a trace touches rather than with the
+ * configured size. Wide sets (large E, fully-associative caches) also
+ * keep a tag index so a lookup does not walk thousands of lines.
+ *
+ * The set index comes from getSetIndex(), plain modulo unless another
+ * index function is selected. A skewed-associative cache drops the sets
+ * and gives every way its own hash instead, see accessSkewed().
+ */
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+void removeLine(cache_t *cache, set_t *set, line_t *popped, line_t *victim) {
+    if(victim) {
+        *victim = *popped;
+    }
+    if(cache->lines.keys) {
+        addrMapRemove(&(cache->lines), popped->tag);
+    }
+    set->ways &= ~(1UL << popped->way);
+    list_del(&(popped->list));
+    free(popped);
+    (set->size)--;
+}
+
+static void freeLineList(struct list_head *head) {
+    struct list_head *listptr, *tmp;
+    line_t *entry;
+    list_for_each_safe(listptr, tmp, head) {
+        entry = list_entry(listptr, line_t, list);
+        list_del(listptr);
+        free(entry);
+    }
+}
+
+bool initCache(cache_t *cache, unsigned set_len, uint64_t line_size, unsigned block_len){
+    memset(cache, 0, sizeof(cache_t));
+    if(set_len + block_len > 64 || set_len > 63 || !line_size) {
+        fprintf(stderr, "Error: Invalid cache geometry s=%u E=%lu b=%u\n", set_len, line_size, block_len);
+        return false;
+    }
+    cache->set_len = set_len;
+    cache->line_size = line_size;
+    cache->block_len = block_len;
+    cache->set_mask = (1UL << set_len) - 1;
+    cache->all_ways = (line_size >= 64) ? ~0UL : (1UL << line_size) - 1;
+    cache->alloc_mask = ~0UL;
+
+    uint64_t set_size = cache->set_mask + 1;
+    if(line_size > LINEAR_SEARCH_WAYS && !initAddrMap(&(cache->lines), 1024)) {
+        return false;
+    }
+    if(set_size > DENSE_SET_LIMIT) {
+        return initAddrMap(&(cache->sparse), 1024);
+    }
+    if(!(cache->sets = calloc(set_size, sizeof(set_t)))) {
+        return false;
+    }
+    // Initialize set array
+    for(uint64_t i = 0; i < set_size; i++) {
+        cache->sets[i].size = 0;
+        cache->sets[i].ways = 0;
+        INIT_LIST_HEAD(&(cache->sets[i].line_head));
+    }
+    return true;
+}
+
+static bool isPrime(uint64_t n) {
+    if(n < 2) {
+        return false;
+    }
+    for(uint64_t d = 2; d * d <= n; d++) {
+        if(n % d == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool setIndexFunction(cache_t *cache, const index_config_t *index){
+    uint64_t sets = cache->set_mask + 1;
+    if(index->fn == INDEX_MATRIX && index->rows != cache->set_len) {
+        fprintf(stderr, "Error: Index matrix needs %u rows, one per index bit\n", cache->set_len);
+        return false;
+    }
+    if(index->skewed && (!cache->sets || cache->line_size > MAX_MASKED_WAYS)) {
+        fprintf(stderr, "Error: Skewed caches are limited to %lu sets and %d ways\n",
+                DENSE_SET_LIMIT, MAX_MASKED_WAYS);
+        return false;
+    }
+    if(index->fn == INDEX_PRIME && cache->set_len > 32) {
+        fprintf(stderr, "Error: Prime indexing is limited to 2^32 sets\n");
+        return false;
+    }
+    cache->index = *index;
+    if(index->fn == INDEX_PRIME) {
+        // A prime index leaves the sets above the prime unused
+        for(cache->prime = sets; cache->prime > 1 && !isPrime(cache->prime); cache->prime--);
+    }
+    if(index->skewed) {
+        size_t slots = sets * cache->line_size;
+        if(!(cache->skew_tags = calloc(slots, sizeof(uint64_t))) ||
+           !(cache->skew_used = calloc(slots, sizeof(uint64_t)))) {
+            perror("Error: ");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseIndexFunction(const char *name, index_fn_t *fn){
+    static const char *names[] = { "modulo", "xor", "prime", "matrix" };
+    for(unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if(!strcasecmp(name, names[i])) {
+            *fn = (index_fn_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * parseIndexMatrix - Read comma separated row masks, the first row giving
+ *                    bit 0 of the set index.
+ */
+bool parseIndexMatrix(const char *rows, index_config_t *index){
+    const char *p = rows;
+    index->rows = 0;
+    while(*p) {
+        char *end;
+        if(index->rows == 64) {
+            fprintf(stderr, "Error: Index matrix has more than 64 rows\n");
+            return false;
+        }
+        index->matrix[index->rows++] = strtoull(p, &end, 0);
+        if(end == p || (*end && *end != ',')) {
+            fprintf(stderr, "Error: Bad index matrix row in '%s'\n", rows);
+            return false;
+        }
+        p = *end ? end + 1 : end;
+    }
+    index->fn = INDEX_MATRIX;
+    return true;
+}
+
+set_t* materializeSet(cache_t *cache, uint64_t index){
+    bool inserted;
+    uint64_t *slot = addrMapInsert(&(cache->sparse), index, 0, &inserted);
+    if(!slot) {
+        perror("Error: ");
+        exit(EXIT_FAILURE);
+    }
+    if(!inserted) {
+        return (set_t*)(uintptr_t)*slot;
+    }
+    if(!cache->slab_count || cache->slab_used == SET_SLAB_SIZE) {
+        set_t **slabs = realloc(cache->slabs, (cache->slab_count + 1) * sizeof(set_t*));
+        if(!slabs || !(slabs[cache->slab_count] = malloc(SET_SLAB_SIZE * sizeof(set_t)))) {
+            perror("Error: ");
+            exit(EXIT_FAILURE);
+        }
+        cache->slabs = slabs;
+        cache->slab_count++;
+        cache->slab_used = 0;
+    }
+    set_t *set = cache->slabs[cache->slab_count - 1] + cache->slab_used++;
+    set->size = 0;
+    set->ways = 0;
+    INIT_LIST_HEAD(&(set->line_head));
+    *slot = (uint64_t)(uintptr_t)set;
+    return set;
+}
+
+uint64_t allocatedSets(const cache_t *cache){
+    if(cache->sets) {
+        return cache->set_mask + 1;
+    }
+    return cache->sparse.count;
+}
+
+void freeCache(cache_t *cache){
+    if(cache->sets) {
+        for(uint64_t i = 0; i <= cache->set_mask; i++) {
+            freeLineList(&(cache->sets[i].line_head));
+        }
+        free(cache->sets);
+        cache->sets = NULL;
+    }
+    for(size_t i = 0; i < cache->slab_count; i++) {
+        size_t used = (i + 1 == cache->slab_count) ? cache->slab_used : SET_SLAB_SIZE;
+        for(size_t j = 0; j < used; j++) {
+            freeLineList(&(cache->slabs[i][j].line_head));
+        }
+        free(cache->slabs[i]);
+    }
+    free(cache->slabs);
+    cache->slabs = NULL;
+    cache->slab_count = 0;
+    if(cache->sparse.keys) {
+        freeAddrMap(&(cache->sparse));
+    }
+    if(cache->lines.keys) {
+        freeAddrMap(&(cache->lines));
+    }
+    free(cache->skew_tags);
+    free(cache->skew_used);
+    cache->skew_tags = cache->skew_used = NULL;
+}
+
+line_t* searchCache(set_t *set, uint64_t tag){
+    line_t *entry;
+    list_for_each_entry(entry, &(set->line_head), list) {
+        if(entry->tag == tag) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+line_t* findLine(cache_t *cache, set_t *set, uint64_t tag){
+    if(cache->lines.keys) {
+        uint64_t *slot = addrMapFind(&(cache->lines), tag);
+        return slot ? (line_t*)(uintptr_t)*slot : NULL;
+    }
+    return searchCache(set, tag);
+}
+
+/*
+ * addLine - Insert tag as the most recently used line of set. Returns true
+ *           if a line had to be evicted, copying it to victim if given.
+ *
+ * With an allocation mask the new line may only replace a way in the mask:
+ * it takes a free way there if any, else evicts the least recently used
+ * line among those ways. Hits are not restricted by the mask.
+ */
+bool addLine(cache_t *cache, set_t *set, uint64_t tag, bool prefetched, line_t *victim){
+    line_t *old = NULL;
+    unsigned way = 0;
+    if(cache->line_size <= MAX_MASKED_WAYS) {
+        uint64_t allowed = cache->all_ways & cache->alloc_mask;
+        uint64_t free_ways = allowed & ~(set->ways);
+        if(free_ways) {
+            way = __builtin_ctzl(free_ways);
+        }
+        else {
+            // First Entry would be the longest not used line
+            list_for_each_entry(old, &(set->line_head), list) {
+                if(allowed & (1UL << old->way)) {
+                    break;
+                }
+            }
+            way = old->way;
+        }
+    }
+    else if(set->size == cache->line_size) {
+        old = list_entry(set->line_head.next, line_t, list);
+    }
+    if(old) {
+        removeLine(cache, set, old, victim);
+    }
+
+    placeLine(cache, set, tag, way)->prefetched = prefetched;
+    return old != NULL;
+}
+
+line_t* placeLine(cache_t *cache, set_t *set, uint64_t tag, unsigned way){
+    line_t* new_cache = (line_t*)calloc(1, sizeof(line_t));
+    if(!new_cache) {
+        perror("Error: ");
+        exit(EXIT_FAILURE);
+    }
+    new_cache->tag = tag;
+    new_cache->way = way;
+    if(cache->lines.keys) {
+        addrMapInsert(&(cache->lines), tag, (uint64_t)(uintptr_t)new_cache, NULL);
+    }
+    set->ways |= 1UL << way;
+
+    //add to back of the list
+    list_add_tail(&(new_cache->list), &(set->line_head));
+    (set->size)++;
+    return new_cache;
+}
+
+/*
+ * accessSkewed - Look tag up in the one slot each way hashes it to. A miss
+ *                fills the least recently used of those slots that the
+ *                allocation mask allows.
+ */
+static result_t accessSkewed(cache_t *cache, uint64_t tag){
+    result_t ret = { 0 };
+    uint64_t sets = cache->set_mask + 1;
+    uint64_t allowed = cache->all_ways & cache->alloc_mask;
+    size_t victim = 0;
+    bool found = false;
+    cache->now++;
+    for(unsigned way = 0; way < cache->line_size; way++) {
+        size_t slot = way * sets + getSkewIndex(cache, tag, way);
+        if(cache->skew_used[slot] && cache->skew_tags[slot] == tag) {
+            cache->skew_used[slot] = cache->now;
+            ret.hit = true;
+            cache->hit_count++;
+            return ret;
+        }
+        if(((allowed >> way) & 1) && (!found || cache->skew_used[slot] < cache->skew_used[victim])) {
+            victim = slot;
+            found = true;
+        }
+    }
+    ret.miss = true;
+    cache->miss_count++;
+    if(cache->skew_used[victim]) {
+        ret.eviction = true;
+        ret.victim.tag = cache->skew_tags[victim];
+        ret.victim.way = victim / sets;
+        cache->eviction_count++;
+    }
+    cache->skew_tags[victim] = tag;
+    cache->skew_used[victim] = cache->now;
+    return ret;
+}
+
+result_t accessCache(cache_t *cache, uint64_t addr){
+    result_t ret = { 0 };
+    line_t *ret_cache;
+    if(cache->skew_tags) {
+        return accessSkewed(cache, getTag(cache, addr));
+    }
+    uint64_t tag = getTag(cache, addr);
+    set_t *set = getSet(cache, tag);
+    cache->now++;
+    // Search if the line is in cache
+    if((ret_cache = findLine(cache, set, tag)) != NULL){
+        // Line Linklist is ordered in used time 
+        // Recently used line would be put to the end
+        list_move_tail(&(ret_cache->list), &(set->line_head));
+        ret.hit = true;
+        if(ret_cache->prefetched) {
+            ret.prefetch_hit = true;
+            ret.late = (ret_cache->ready_time > cache->now);
+            ret_cache->prefetched = false;
+        }
+        cache->hit_count++;
+    }
+    else {
+        ret.miss = true;
+        cache->miss_count++;
+        // addLine() return true if there's eviction happened
+        if(addLine(cache, set, tag, false, &ret.victim)){
+            ret.eviction = true;
+            cache->eviction_count++;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,190 @@
+/*
+ * cache.h - Set-associative LRU cache model used by the simulator
+ */
+#ifndef CSIM_CACHE_H
+#define CSIM_CACHE_H
+
+#include "list.h"
+#include "addrmap.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct line{
+    uint64_t tag;
+    struct list_head list;
+    // Way the line sits in, tracked for caches of up to MAX_MASKED_WAYS
+    unsigned way;
+    // Filled by a prefetcher and not demanded yet
+    bool prefetched;
+    // Access number at which a prefetch fill arrives
+    uint64_t ready_time;
+    // Coherence state, only used by the multi-core model
+    uint8_t state;
+    // Written since the fill, only tracked when checkpointing
+    bool dirty;
+}line_t;
+
+typedef struct set{
+    size_t size;
+    struct list_head line_head;
+    // Bitmap of occupied ways
+    uint64_t ways;
+}set_t;
+
+typedef struct result{
+    bool miss;
+    bool hit;
+    bool eviction;
+    // Hit on a prefetched line, and whether its fill was still in flight
+    bool prefetch_hit;
+    bool late;
+    // Copy of the evicted line when eviction is set
+    line_t victim;
+}result_t;
+
+// Caches with more sets than this only allocate the sets they touch
+#define DENSE_SET_LIMIT (1UL << 16)
+// Sets wider than this find lines through a hash index instead of a walk
+#define LINEAR_SEARCH_WAYS 16
+#define SET_SLAB_SIZE 1024
+// Way allocation masks only apply to caches with at most this many ways
+#define MAX_MASKED_WAYS 64
+
+// Functions mapping a block number to a set
+typedef enum {
+    INDEX_MODULO,   // low bits of the block number
+    INDEX_XOR,      // XOR of every set-width field of the block number
+    INDEX_PRIME,    // block number modulo the largest prime <= sets
+    INDEX_MATRIX    // parity of the block number under a mask per index bit
+} index_fn_t;
+
+typedef struct index_config{
+    index_fn_t fn;
+    // Each way indexes with its own hash (skewed-associative cache)
+    bool skewed;
+    // Row i selects the block number bits whose parity is index bit i
+    uint64_t matrix[64];
+    unsigned rows;
+}index_config_t;
+
+typedef struct counters{
+    uint64_t hits, misses, evictions;
+}counters_t;
+
+typedef struct cache{
+    unsigned set_len;
+    uint64_t line_size;
+    unsigned block_len;
+    // Applied to a tag to get its set index
+    uint64_t set_mask;
+    index_config_t index;
+    uint64_t prime;
+    // Dense caches keep every set in one array. Sparse caches map set
+    // index to a set allocated from slabs the first time it is touched.
+    set_t *sets;
+    addrmap_t sparse;
+    set_t **slabs;
+    size_t slab_count, slab_used;
+    // Tag to line_t* of every cached line, only for wide sets
+    addrmap_t lines;
+    // Ways of the cache, and the ways the next fill may replace (CAT-style)
+    uint64_t all_ways;
+    uint64_t alloc_mask;
+    // Number of demand accesses seen so far, used as simulated time
+    uint64_t now;
+    uint64_t hit_count, miss_count, eviction_count;
+    // Skewed caches keep way w of set i at slot w * sets + i, with the
+    // access time of each slot (0 when empty) standing in for LRU order
+    uint64_t *skew_tags;
+    uint64_t *skew_used;
+}cache_t;
+
+// Tags keep the set bits, so a tag is also the block number
+static inline uint64_t getTag(const cache_t *cache, uint64_t addr){
+    return addr >> cache->block_len;
+}
+
+static inline uint64_t getSetIndex(const cache_t *cache, uint64_t tag){
+    switch(cache->index.fn) {
+        case INDEX_MODULO:
+            return tag & cache->set_mask;
+        case INDEX_XOR: {
+            uint64_t index = 0;
+            if(!cache->set_len) {
+                return 0;
+            }
+            for(; tag; tag >>= cache->set_len) {
+                index ^= tag;
+            }
+            return index & cache->set_mask;
+        }
+        case INDEX_PRIME:
+            return tag % cache->prime;
+        case INDEX_MATRIX: {
+            uint64_t index = 0;
+            for(unsigned i = 0; i < cache->index.rows; i++) {
+                index |= (uint64_t)__builtin_parityl(tag & cache->index.matrix[i]) << i;
+            }
+            return index;
+        }
+    }
+    return 0;
+}
+
+// Way w of a skewed cache hashes the block number with its upper part
+// rotated by w, so blocks that collide in one way spread out in the others
+static inline uint64_t getSkewIndex(const cache_t *cache, uint64_t tag, unsigned way){
+    uint64_t high = tag >> cache->set_len;
+    if(way) {
+        high = (high << way) | (high >> (64 - way));
+    }
+    return getSetIndex(cache, tag ^ high);
+}
+
+// Bytes of the block addr falls in that [addr, addr + size) covers. Blocks
+// over 64 bytes get one bit per 1/64 of the block.
+static inline uint64_t getByteMask(const cache_t *cache, uint64_t addr, uint64_t size){
+    unsigned chunk_len = cache->block_len > 6 ? cache->block_len - 6 : 0;
+    uint64_t offset = addr & ((1UL << cache->block_len) - 1);
+    uint64_t last = offset + (size ? size : 1) - 1;
+    if(last >> cache->block_len) {
+        last = (1UL << cache->block_len) - 1;
+    }
+    unsigned first_bit = offset >> chunk_len, last_bit = last >> chunk_len;
+    uint64_t upto = (last_bit == 63) ? ~0UL : (1UL << (last_bit + 1)) - 1;
+    return upto & ~((1UL << first_bit) - 1);
+}
+
+set_t* materializeSet(cache_t *cache, uint64_t index);
+
+static inline set_t* getSet(cache_t *cache, uint64_t tag){
+    if(cache->sets) {
+        return cache->sets + getSetIndex(cache, tag);
+    }
+    return materializeSet(cache, getSetIndex(cache, tag));
+}
+
+static inline void countResult(counters_t *count, const result_t *ret){
+    count->hits += ret->hit;
+    count->misses += ret->miss;
+    count->evictions += ret->eviction;
+}
+
+bool initCache(cache_t *cache, unsigned set_len, uint64_t line_size, unsigned block_len);
+void freeCache(cache_t *cache);
+// Switch an empty cache to another index function
+bool setIndexFunction(cache_t *cache, const index_config_t *index);
+bool parseIndexFunction(const char *name, index_fn_t *fn);
+bool parseIndexMatrix(const char *rows, index_config_t *index);
+// Number of sets actually allocated
+uint64_t allocatedSets(const cache_t *cache);
+
+line_t* searchCache(set_t *set, uint64_t tag);
+line_t* findLine(cache_t *cache, set_t *set, uint64_t tag);
+bool addLine(cache_t *cache, set_t *set, uint64_t tag, bool prefetched, line_t *victim);
+void removeLine(cache_t *cache, set_t *set, line_t *line, line_t *victim);
+// Append tag as the most recently used line of set, in a way that is free
+line_t* placeLine(cache_t *cache, set_t *set, uint64_t tag, unsigned way);
+result_t accessCache(cache_t *cache, uint64_t addr);
+
+#endif /* CSIM_CACHE_H */
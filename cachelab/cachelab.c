@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 #include "cachelab.h"
 #include <time.h>
 
@@ -39,6 +40,21 @@ void initMatrix(int M, int N, int A[N][M], int B[M][N])
     }
 }
 
+/*
+ * initMatrixElems - Fill A and B, N x M and M x N elements of size
+ *     bytes, with random bytes
+ */
+void initMatrixElems(int M, int N, size_t size, void *A, void *B)
+{
+    unsigned char *a = A, *b = B;
+    size_t i;
+    srand(time(NULL));
+    for (i = 0; i < (size_t)M * N * size; i++) {
+        a[i] = rand();
+        b[i] = rand();
+    }
+}
+
 void randMatrix(int M, int N, int A[N][M]) {
     int i, j;
     srand(time(NULL));
@@ -65,6 +81,32 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N])
 }
 
 
+/*
+ * correctTransElems - correctTrans() for elements of size bytes
+ */
+void correctTransElems(int M, int N, size_t size, const void *A, void *B)
+{
+    const char *a = A;
+    char *b = B;
+    int i, j;
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < M; j++) {
+            memcpy(b + ((size_t)j * N + i) * size, a + ((size_t)i * M + j) * size, size);
+        }
+    }
+}
+
+/*
+ * layoutMatrices - Place A (N rows of M + a_pad elements) and B (M rows
+ *     of N + b_pad elements) in the tracegen arena as layout describes
+ */
+void layoutMatrices(const layout_t *layout, int M, int N, size_t size,
+                    unsigned long *a_start, unsigned long *b_start)
+{
+    unsigned long a_end = layout->a_offset + size * N * (M + layout->a_pad);
+    *a_start = layout->a_offset;
+    *b_start = (a_end + layout->align - 1) / layout->align * layout->align + layout->b_offset;
+}
 
 /* 
  * registerTransFunction - Add the given trans function into your list
@@ -72,12 +114,37 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N])
  */
 void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]), 
                            char* desc)
+{
+    registerOrderedTransFunction(trans, desc, ORDER_ROW_MAJOR);
+}
+
+/*
+ * registerOrderedTransFunction - Add a trans function that works on A
+ *     and B stored in the given order, rather than row-major
+ */
+void registerOrderedTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
+                                  char* desc, order_t order)
 {
     func_list[func_counter].func_ptr = trans;
+    func_list[func_counter].elem_func = NULL;
+    func_list[func_counter].elem_size = sizeof(int);
     func_list[func_counter].description = desc;
+    func_list[func_counter].order = order;
     func_list[func_counter].correct = 0;
     func_list[func_counter].num_hits = 0;
     func_list[func_counter].num_misses = 0;
     func_list[func_counter].num_evictions =0;
     func_counter++;
 }
+
+/*
+ * registerElemTransFunction - Add a trans function for row-major
+ *     matrices of size byte elements into your list of functions
+ */
+void registerElemTransFunction(void (*trans)(int M, int N, void *A, void *B),
+                               char* desc, size_t size)
+{
+    registerOrderedTransFunction(NULL, desc, ORDER_ROW_MAJOR);
+    func_list[func_counter - 1].elem_func = trans;
+    func_list[func_counter - 1].elem_size = size;
+}
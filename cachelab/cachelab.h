@@ -5,17 +5,44 @@
 #ifndef CACHELAB_TOOLS_H
 #define CACHELAB_TOOLS_H
 
+#include <stddef.h>
+
 #define MAX_TRANS_FUNCS 100
 
+/* How a transpose function expects A and B to be stored */
+typedef enum order{
+  ORDER_ROW_MAJOR = 0,
+  ORDER_BLOCKED,        /* 8x8 tiles, row-major within and between tiles */
+  ORDER_MORTON          /* Z-order, row and column bits interleaved */
+} order_t;
+
 typedef struct trans_func{
   void (*func_ptr)(int M,int N,int[N][M],int[M][N]);
+  /* Functions of other element types are type-erased, func_ptr is NULL */
+  void (*elem_func)(int M,int N,void *A,void *B);
+  size_t elem_size;
   char* description;
+  order_t order;
   char correct;
   unsigned int num_hits;
   unsigned int num_misses;
   unsigned int num_evictions;
 } trans_func_t;
 
+/*
+ * Placement of A and B in the tracegen arena. A starts a_offset bytes
+ * into the arena, B b_offset bytes past the first multiple of align
+ * after A. Rows are padded by a_pad and b_pad elements.
+ */
+typedef struct layout{
+  unsigned long a_offset, b_offset;
+  unsigned long align;
+  int a_pad, b_pad;
+} layout_t;
+
+/* The static A[256][256] and B[256][256] tracegen used to have */
+#define DEFAULT_LAYOUT_ALIGN (256 * 256 * sizeof(int))
+
 /* 
  * printSummary - This function provides a standard way for your cache
  * simulator * to display its final hit and miss statistics
@@ -30,8 +57,25 @@ void initMatrix(int M, int N, int A[N][M], int B[M][N]);
 /* The baseline trans function that produces correct results. */
 void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 
+/* initMatrix() and correctTrans() for elements of size bytes */
+void initMatrixElems(int M, int N, size_t size, void *A, void *B);
+void correctTransElems(int M, int N, size_t size, const void *A, void *B);
+
+/* Byte offsets of A and B, of size byte elements, from the start of
+   the tracegen arena */
+void layoutMatrices(const layout_t *layout, int M, int N, size_t size,
+                    unsigned long *a_start, unsigned long *b_start);
+
 /* Add the given function to the function list */
 void registerTransFunction(
     void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc);
 
+/* Add a function that takes A and gives B stored in the given order */
+void registerOrderedTransFunction(
+    void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc, order_t order);
+
+/* Add a function transposing row-major matrices of size byte elements */
+void registerElemTransFunction(
+    void (*trans)(int M,int N,void *A,void *B), char* desc, size_t size);
+
 #endif /* CACHELAB_TOOLS_H */
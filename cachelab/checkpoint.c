@@ -0,0 +1,206 @@
+/*
+ * checkpoint.c - Snapshots of the full cache state
+ *
+ * A snapshot holds, all little-endian:
+ *
+ *   header   magic "CSIMCKPT", u32 version, u32 set_len, u32 block_len,
+ *            u32 index function, u64 ways, u64 alloc_mask, u64 trace
+ *            offset, u64 now, hits, misses, evictions, u64 set count
+ *   sets     u64 set index, u32 line count, then per line from least to
+ *            most recently used: u64 tag, u8 way, u8 flags
+ *   trailer  u64 hash of everything before it
+ *
+ * Only sets holding lines are stored, so a snapshot grows with the data
+ * cached rather than with the geometry. Loading checks the version, the
+ * geometry and the hash before touching the cache.
+ */
+#include "checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ckpt_file{
+    FILE *fptr;
+    uint64_t hash;
+    bool ok;
+}ckpt_file_t;
+
+static void hashBytes(ckpt_file_t *f, const void *data, size_t len){
+    const unsigned char *p = data;
+    for(size_t i = 0; i < len; i++) {
+        f->hash = (f->hash ^ p[i]) * 0x100000001B3UL;
+    }
+}
+
+static void put(ckpt_file_t *f, const void *data, size_t len){
+    hashBytes(f, data, len);
+    f->ok &= (fwrite(data, 1, len, f->fptr) == len);
+}
+
+static void get(ckpt_file_t *f, void *data, size_t len){
+    if(f->ok && fread(data, 1, len, f->fptr) == len) {
+        hashBytes(f, data, len);
+    }
+    else {
+        f->ok = false;
+        memset(data, 0, len);
+    }
+}
+
+static void putU64(ckpt_file_t *f, uint64_t v){
+    put(f, &v, sizeof(v));
+}
+
+static void putU32(ckpt_file_t *f, uint32_t v){
+    put(f, &v, sizeof(v));
+}
+
+static uint64_t getU64(ckpt_file_t *f){
+    uint64_t v;
+    get(f, &v, sizeof(v));
+    return v;
+}
+
+static uint32_t getU32(ckpt_file_t *f){
+    uint32_t v;
+    get(f, &v, sizeof(v));
+    return v;
+}
+
+static void putSet(ckpt_file_t *f, uint64_t index, set_t *set){
+    line_t *line;
+    putU64(f, index);
+    putU32(f, (uint32_t)set->size);
+    list_for_each_entry(line, &(set->line_head), list) {
+        uint8_t way = (uint8_t)line->way;
+        uint8_t flags = (line->prefetched ? CKPT_PREFETCHED : 0) | (line->dirty ? CKPT_DIRTY : 0);
+        putU64(f, line->tag);
+        put(f, &way, 1);
+        put(f, &flags, 1);
+    }
+}
+
+bool saveCheckpoint(const cache_t *cache, uint64_t offset, const char *file){
+    ckpt_file_t f = { fopen(file, "wb"), 0xCBF29CE484222325UL, true };
+    uint64_t sets = 0;
+    if(!f.fptr) {
+        perror("Error: ");
+        return false;
+    }
+    if(cache->skew_tags) {
+        fprintf(stderr, "Error: Skewed caches cannot be checkpointed\n");
+        fclose(f.fptr);
+        return false;
+    }
+    // Count the sets holding lines first, the header records it
+    for(uint64_t i = 0; cache->sets && i <= cache->set_mask; i++) {
+        sets += (cache->sets[i].size != 0);
+    }
+    for(size_t i = 0; !cache->sets && i < cache->sparse.capacity; i++) {
+        if(cache->sparse.keys[i] != ADDRMAP_EMPTY) {
+            sets += (((set_t*)(uintptr_t)cache->sparse.vals[i])->size != 0);
+        }
+    }
+    put(&f, CHECKPOINT_MAGIC, 8);
+    putU32(&f, CHECKPOINT_VERSION);
+    putU32(&f, cache->set_len);
+    putU32(&f, cache->block_len);
+    putU32(&f, cache->index.fn);
+    putU64(&f, cache->line_size);
+    putU64(&f, cache->alloc_mask);
+    putU64(&f, offset);
+    putU64(&f, cache->now);
+    putU64(&f, cache->hit_count);
+    putU64(&f, cache->miss_count);
+    putU64(&f, cache->eviction_count);
+    putU64(&f, sets);
+    for(uint64_t i = 0; cache->sets && i <= cache->set_mask; i++) {
+        if(cache->sets[i].size) {
+            putSet(&f, i, cache->sets + i);
+        }
+    }
+    for(size_t i = 0; !cache->sets && i < cache->sparse.capacity; i++) {
+        set_t *set = (set_t*)(uintptr_t)cache->sparse.vals[i];
+        if(cache->sparse.keys[i] != ADDRMAP_EMPTY && set->size) {
+            putSet(&f, cache->sparse.keys[i], set);
+        }
+    }
+    uint64_t hash = f.hash;
+    put(&f, &hash, sizeof(hash));
+    f.ok &= (fclose(f.fptr) == 0);
+    if(!f.ok) {
+        fprintf(stderr, "Error: Could not write checkpoint %s\n", file);
+    }
+    return f.ok;
+}
+
+bool loadCheckpoint(cache_t *cache, const char *file, uint64_t *offset){
+    ckpt_file_t f = { fopen(file, "rb"), 0xCBF29CE484222325UL, true };
+    char magic[8];
+    if(!f.fptr) {
+        perror("Error: ");
+        return false;
+    }
+    get(&f, magic, 8);
+    uint32_t version = getU32(&f);
+    if(!f.ok || memcmp(magic, CHECKPOINT_MAGIC, 8) || version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "Error: %s is not a version %d checkpoint\n", file, CHECKPOINT_VERSION);
+        fclose(f.fptr);
+        return false;
+    }
+    uint32_t set_len = getU32(&f), block_len = getU32(&f), index_fn = getU32(&f);
+    uint64_t line_size = getU64(&f);
+    if(set_len != cache->set_len || block_len != cache->block_len || line_size != cache->line_size ||
+       index_fn != cache->index.fn) {
+        fprintf(stderr, "Error: Checkpoint %s is for s=%u E=%lu b=%u\n", file, set_len, line_size, block_len);
+        fclose(f.fptr);
+        return false;
+    }
+    cache->alloc_mask = getU64(&f);
+    *offset = getU64(&f);
+    cache->now = getU64(&f);
+    cache->hit_count = getU64(&f);
+    cache->miss_count = getU64(&f);
+    cache->eviction_count = getU64(&f);
+    uint64_t sets = getU64(&f);
+    for(uint64_t i = 0; f.ok && i < sets; i++) {
+        uint64_t index = getU64(&f);
+        uint32_t count = getU32(&f);
+        if(index > cache->set_mask || count > line_size) {
+            f.ok = false;
+            break;
+        }
+        set_t *set = cache->sets ? cache->sets + index : materializeSet(cache, index);
+        for(uint32_t j = 0; f.ok && j < count; j++) {
+            uint64_t tag = getU64(&f);
+            uint8_t way, flags;
+            get(&f, &way, 1);
+            get(&f, &flags, 1);
+            // Ways index the 64-bit occupancy bitmap of the set
+            if(way >= 64) {
+                f.ok = false;
+            }
+            if(f.ok) {
+                line_t *line = placeLine(cache, set, tag, way);
+                line->prefetched = (flags & CKPT_PREFETCHED) != 0;
+                line->dirty = (flags & CKPT_DIRTY) != 0;
+            }
+        }
+    }
+    uint64_t expected = f.hash, hash;
+    get(&f, &hash, sizeof(hash));
+    fclose(f.fptr);
+    if(!f.ok || hash != expected) {
+        fprintf(stderr, "Error: Checkpoint %s is truncated or corrupt\n", file);
+        return false;
+    }
+    return true;
+}
+
+void markDirty(cache_t *cache, uint64_t addr){
+    uint64_t tag = getTag(cache, addr);
+    line_t *line;
+    if(!cache->skew_tags && (line = findLine(cache, getSet(cache, tag), tag))) {
+        line->dirty = true;
+    }
+}
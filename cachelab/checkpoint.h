@@ -0,0 +1,24 @@
+/*
+ * checkpoint.h - Snapshots of the full cache state at a trace offset
+ */
+#ifndef CSIM_CHECKPOINT_H
+#define CSIM_CHECKPOINT_H
+
+#include "cache.h"
+
+#define CHECKPOINT_MAGIC "CSIMCKPT"
+#define CHECKPOINT_VERSION 1
+
+// Line flags in a snapshot
+#define CKPT_PREFETCHED 0x1
+#define CKPT_DIRTY 0x2
+
+// Write the state of cache after offset trace records to file
+bool saveCheckpoint(const cache_t *cache, uint64_t offset, const char *file);
+// Fill an empty cache of the same geometry from file, returning its offset
+bool loadCheckpoint(cache_t *cache, const char *file, uint64_t *offset);
+
+// Mark the line holding addr as written
+void markDirty(cache_t *cache, uint64_t addr);
+
+#endif /* CSIM_CHECKPOINT_H */
@@ -0,0 +1,108 @@
+/*
+ * classify.c - 3C miss classification
+ *
+ * A miss on a block never touched before is compulsory. Otherwise the
+ * access is replayed on a fully-associative LRU cache of the same size:
+ * if that cache misses too the miss is a capacity miss, else a conflict
+ * miss. The shadow cache is a hash map into a pool of lines, grown in
+ * chunks as the cache fills and linked in LRU order, so each access
+ * costs two hash lookups and a list move.
+ */
+#include "classify.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+bool initClassifier(classifier_t *cl, uint64_t capacity){
+    cl->capacity = capacity;
+    cl->used = 0;
+    cl->chunks = NULL;
+    cl->chunk_count = 0;
+    cl->compulsory = cl->capacity_misses = cl->conflict = 0;
+    INIT_LIST_HEAD(&(cl->lru));
+    if(!initAddrMap(&(cl->seen), 1024)) {
+        return false;
+    }
+    if(!initAddrMap(&(cl->shadow), 1024)) {
+        freeAddrMap(&(cl->seen));
+        return false;
+    }
+    return true;
+}
+
+void freeClassifier(classifier_t *cl){
+    freeAddrMap(&(cl->seen));
+    freeAddrMap(&(cl->shadow));
+    for(size_t i = 0; i < cl->chunk_count; i++) {
+        free(cl->chunks[i]);
+    }
+    free(cl->chunks);
+    cl->chunks = NULL;
+}
+
+static inline shadow_line_t* poolLine(const classifier_t *cl, uint64_t index){
+    return cl->chunks[index / SHADOW_CHUNK] + (index % SHADOW_CHUNK);
+}
+
+static shadow_line_t* newPoolLine(classifier_t *cl){
+    if(cl->used == (uint64_t)cl->chunk_count * SHADOW_CHUNK) {
+        shadow_line_t **chunks = realloc(cl->chunks, (cl->chunk_count + 1) * sizeof(shadow_line_t*));
+        if(!chunks || !(chunks[cl->chunk_count] = malloc(SHADOW_CHUNK * sizeof(shadow_line_t)))) {
+            perror("Error: ");
+            exit(EXIT_FAILURE);
+        }
+        cl->chunks = chunks;
+        cl->chunk_count++;
+    }
+    return poolLine(cl, cl->used++);
+}
+
+// Access the shadow cache, returns true on a hit
+static bool accessShadow(classifier_t *cl, uint64_t tag){
+    uint64_t *slot = addrMapFind(&(cl->shadow), tag);
+    shadow_line_t *line;
+    uint64_t index;
+    if(slot) {
+        line = poolLine(cl, *slot);
+        list_move_tail(&(line->list), &(cl->lru));
+        return true;
+    }
+    if(cl->used < cl->capacity) {
+        index = cl->used;
+        line = newPoolLine(cl);
+    }
+    else {
+        // Reuse the least recently used line
+        line = list_entry(cl->lru.next, shadow_line_t, list);
+        index = *addrMapFind(&(cl->shadow), line->tag);
+        addrMapRemove(&(cl->shadow), line->tag);
+        list_del(&(line->list));
+    }
+    line->tag = tag;
+    list_add_tail(&(line->list), &(cl->lru));
+    addrMapInsert(&(cl->shadow), tag, index, NULL);
+    return false;
+}
+
+miss_class_t classifyAccess(classifier_t *cl, uint64_t tag, bool miss){
+    bool first = false;
+    addrMapInsert(&(cl->seen), tag, 0, &first);
+    bool shadow_hit = accessShadow(cl, tag);
+    if(!miss) {
+        return MISS_NONE;
+    }
+    if(first) {
+        cl->compulsory++;
+        return MISS_COMPULSORY;
+    }
+    if(!shadow_hit) {
+        cl->capacity_misses++;
+        return MISS_CAPACITY;
+    }
+    cl->conflict++;
+    return MISS_CONFLICT;
+}
+
+void printClassifierStats(const classifier_t *cl){
+    printf("3c: compulsory:%lu capacity:%lu conflict:%lu\n",
+           cl->compulsory, cl->capacity_misses, cl->conflict);
+}
@@ -0,0 +1,46 @@
+/*
+ * classify.h - Compulsory / capacity / conflict miss classification
+ */
+#ifndef CSIM_CLASSIFY_H
+#define CSIM_CLASSIFY_H
+
+#include "list.h"
+#include "addrmap.h"
+
+typedef enum miss_class{
+    MISS_NONE = 0,
+    MISS_COMPULSORY,
+    MISS_CAPACITY,
+    MISS_CONFLICT
+}miss_class_t;
+
+// Line of the shadow fully-associative cache
+typedef struct shadow_line{
+    uint64_t tag;
+    struct list_head list;
+}shadow_line_t;
+
+typedef struct classifier{
+    // Every block touched so far
+    addrmap_t seen;
+    // Shadow cache: tag to pool index, pool lines kept in LRU order. The
+    // pool grows in chunks so memory follows the lines actually used.
+    addrmap_t shadow;
+    shadow_line_t **chunks;
+    size_t chunk_count;
+    uint64_t capacity, used;
+    struct list_head lru;
+    uint64_t compulsory, capacity_misses, conflict;
+}classifier_t;
+
+#define SHADOW_CHUNK 4096
+
+// capacity is the number of lines of the simulated cache
+bool initClassifier(classifier_t *cl, uint64_t capacity);
+void freeClassifier(classifier_t *cl);
+
+// Feed every demand access in order, returns the class of a miss
+miss_class_t classifyAccess(classifier_t *cl, uint64_t tag, bool miss);
+void printClassifierStats(const classifier_t *cl);
+
+#endif /* CSIM_CLASSIFY_H */
@@ -0,0 +1,253 @@
+/*
+ * coherence.c - Multi-core simulation with snooping MESI/MOESI coherence
+ *
+ * Every core owns a private cache of the configured geometry. Misses
+ * snoop the other caches: a read finds the line Exclusive when no other
+ * core holds it and Shared otherwise, and a write invalidates every
+ * other copy. Under MESI a Modified line that is read by another core is
+ * written back; under MOESI it becomes Owned and keeps supplying data.
+ *
+ * When a core loses a line to another core's write, the bytes other
+ * cores write to the line from then on are remembered, including the
+ * writes the new owner makes while it holds the line in M. The next miss
+ * of that core on the line is a coherence miss, and a false sharing miss
+ * if it uses none of those bytes. Byte masks are 64 bits, so blocks over 64 bytes are tracked in
+ * block/64 byte chunks.
+ */
+#include "coherence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *protocol_names[] = {"mesi", "moesi"};
+
+bool parseProtocol(const char *name, protocol_t *protocol){
+    for(size_t i = 0; i < sizeof(protocol_names) / sizeof(protocol_names[0]); i++) {
+        if(strcmp(name, protocol_names[i]) == 0) {
+            *protocol = (protocol_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool initCoherence(coherence_t *coh, protocol_t protocol, unsigned cores,
+                   unsigned set_len, uint64_t line_size, unsigned block_len){
+    memset(coh, 0, sizeof(coherence_t));
+    if(cores == 0 || cores > MAX_CORES) {
+        fprintf(stderr, "Error: Core count must be 1 to %d\n", MAX_CORES);
+        return false;
+    }
+    coh->protocol = protocol;
+    coh->cores = cores;
+    for(unsigned i = 0; i < cores; i++) {
+        if(!initCache(coh->caches + i, set_len, line_size, block_len) ||
+           !initAddrMap(coh->invalidated + i, 64)) {
+            return false;
+        }
+    }
+    return initAddrMap(&(coh->false_lines), 64);
+}
+
+void freeCoherence(coherence_t *coh){
+    for(unsigned i = 0; i < coh->cores; i++) {
+        freeCache(coh->caches + i);
+        freeAddrMap(coh->invalidated + i);
+    }
+    freeAddrMap(&(coh->false_lines));
+}
+
+static line_t* snoop(coherence_t *coh, unsigned core, uint64_t tag, set_t **set){
+    cache_t *cache = coh->caches + core;
+    *set = getSet(cache, tag);
+    return findLine(cache, *set, tag);
+}
+
+// Drop every other copy of tag on a write by core; recordWrite() adds the
+// bytes written to what the dropped copies missed
+static void invalidateOthers(coherence_t *coh, unsigned core, uint64_t tag){
+    for(unsigned i = 0; i < coh->cores; i++) {
+        set_t *set;
+        line_t *line;
+        if(i == core || !(line = snoop(coh, i, tag, &set))) {
+            continue;
+        }
+        // A dirty copy hands its data over with the ownership
+        if(line->state == STATE_M || line->state == STATE_O) {
+            coh->transfers++;
+        }
+        removeLine(coh->caches + i, set, line, NULL);
+        coh->invalidations++;
+        addrMapInsert(coh->invalidated + i, tag, 0, NULL);
+    }
+}
+
+// Add the bytes core wrote to tag to the mask of every core that lost it
+static void recordWrite(coherence_t *coh, unsigned core, uint64_t tag, uint64_t mask){
+    for(unsigned i = 0; i < coh->cores; i++) {
+        uint64_t *written;
+        if(i != core && (written = addrMapFind(coh->invalidated + i, tag))) {
+            *written |= mask;
+        }
+    }
+}
+
+// Snoop a read miss of core, returns true if another core holds the line
+static bool shareOthers(coherence_t *coh, unsigned core, uint64_t tag){
+    bool shared = false;
+    for(unsigned i = 0; i < coh->cores; i++) {
+        set_t *set;
+        line_t *line;
+        if(i == core || !(line = snoop(coh, i, tag, &set))) {
+            continue;
+        }
+        shared = true;
+        switch(line->state) {
+            case STATE_M: {
+                coh->transfers++;
+                if(coh->protocol == PROTOCOL_MOESI) {
+                    line->state = STATE_O;
+                }
+                else {
+                    coh->writebacks++;
+                    line->state = STATE_S;
+                }
+                break;
+            }
+            case STATE_O: {
+                coh->transfers++;
+                break;
+            }
+            case STATE_E: {
+                line->state = STATE_S;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return shared;
+}
+
+static void countFalseSharing(coherence_t *coh, unsigned core, uint64_t tag, uint64_t mask){
+    uint64_t *written = addrMapFind(coh->invalidated + core, tag);
+    if(!written) {
+        return;
+    }
+    coh->stats[core].coherence_misses++;
+    if(!(*written & mask)) {
+        coh->stats[core].false_sharing++;
+        (*addrMapInsert(&(coh->false_lines), tag, 0, NULL))++;
+    }
+    addrMapRemove(coh->invalidated + core, tag);
+}
+
+result_t coherentAccess(coherence_t *coh, unsigned core, uint64_t addr, uint64_t size, bool write){
+    result_t ret = { 0 };
+    cache_t *cache = coh->caches + core;
+    uint64_t tag = getTag(cache, addr);
+    uint64_t mask = getByteMask(cache, addr, size);
+    set_t *set = getSet(cache, tag);
+    line_t *line = findLine(cache, set, tag);
+    cache->now++;
+
+    if(line) {
+        list_move_tail(&(line->list), &(set->line_head));
+        ret.hit = true;
+        cache->hit_count++;
+        if(write && line->state != STATE_M) {
+            // Exclusive lines upgrade silently, shared ones must invalidate
+            if(line->state != STATE_E) {
+                invalidateOthers(coh, core, tag);
+                coh->stats[core].upgrades++;
+            }
+            line->state = STATE_M;
+        }
+        if(write) {
+            recordWrite(coh, core, tag, mask);
+        }
+        return ret;
+    }
+
+    ret.miss = true;
+    cache->miss_count++;
+    countFalseSharing(coh, core, tag, mask);
+    line_state_t state;
+    if(write) {
+        invalidateOthers(coh, core, tag);
+        recordWrite(coh, core, tag, mask);
+        state = STATE_M;
+    }
+    else {
+        state = shareOthers(coh, core, tag) ? STATE_S : STATE_E;
+    }
+    if(addLine(cache, set, tag, false, &ret.victim)) {
+        ret.eviction = true;
+        cache->eviction_count++;
+        if(ret.victim.state == STATE_M || ret.victim.state == STATE_O) {
+            coh->writebacks++;
+        }
+    }
+    list_entry(set->line_head.prev, line_t, list)->state = state;
+    return ret;
+}
+
+counters_t coherenceTotals(const coherence_t *coh){
+    counters_t total = { 0 };
+    for(unsigned i = 0; i < coh->cores; i++) {
+        total.hits += coh->caches[i].hit_count;
+        total.misses += coh->caches[i].miss_count;
+        total.evictions += coh->caches[i].eviction_count;
+    }
+    return total;
+}
+
+typedef struct false_line{
+    uint64_t tag, misses;
+}false_line_t;
+
+static int compareFalseLines(const void *a, const void *b){
+    const false_line_t *x = a, *y = b;
+    if(x->misses != y->misses) {
+        return x->misses < y->misses ? 1 : -1;
+    }
+    return x->tag < y->tag ? -1 : (x->tag > y->tag);
+}
+
+void printCoherenceStats(const coherence_t *coh){
+    uint64_t coherence_misses = 0, false_sharing = 0;
+    for(unsigned i = 0; i < coh->cores; i++) {
+        const cache_t *cache = coh->caches + i;
+        const core_stats_t *stats = coh->stats + i;
+        printf("core %u: hits:%lu misses:%lu evictions:%lu upgrades:%lu "
+               "coherence-misses:%lu false-sharing:%lu\n", i, cache->hit_count,
+               cache->miss_count, cache->eviction_count, stats->upgrades,
+               stats->coherence_misses, stats->false_sharing);
+        coherence_misses += stats->coherence_misses;
+        false_sharing += stats->false_sharing;
+    }
+    printf("coherence(%s): invalidations:%lu transfers:%lu writebacks:%lu "
+           "coherence-misses:%lu false-sharing:%lu\n", protocol_names[coh->protocol],
+           coh->invalidations, coh->transfers, coh->writebacks, coherence_misses,
+           false_sharing);
+
+    // Sort the lines by false sharing misses, worst first
+    const addrmap_t *lines = &(coh->false_lines);
+    size_t count = 0;
+    false_line_t *sorted = malloc(lines->count * sizeof(false_line_t) + 1);
+    if(!sorted) {
+        return;
+    }
+    for(size_t i = 0; i < lines->capacity; i++) {
+        if(lines->keys[i] != ADDRMAP_EMPTY) {
+            sorted[count].tag = lines->keys[i];
+            sorted[count++].misses = lines->vals[i];
+        }
+    }
+    qsort(sorted, count, sizeof(false_line_t), compareFalseLines);
+    for(size_t i = 0; i < count && i < FALSE_SHARING_TOP; i++) {
+        printf("false-sharing line 0x%lx: misses:%lu\n",
+               sorted[i].tag << coh->caches[0].block_len, sorted[i].misses);
+    }
+    free(sorted);
+}
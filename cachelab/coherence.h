@@ -0,0 +1,56 @@
+/*
+ * coherence.h - Private per-core caches kept coherent with MESI or MOESI
+ */
+#ifndef CSIM_COHERENCE_H
+#define CSIM_COHERENCE_H
+
+#include "cache.h"
+#include "addrmap.h"
+
+#define MAX_CORES 64
+// Lines listed in the false sharing report
+#define FALSE_SHARING_TOP 10
+
+typedef enum line_state{
+    STATE_I = 0,
+    STATE_S,
+    STATE_E,
+    STATE_O,
+    STATE_M
+}line_state_t;
+
+typedef enum protocol{
+    PROTOCOL_MESI = 0,
+    PROTOCOL_MOESI
+}protocol_t;
+
+typedef struct core_stats{
+    uint64_t upgrades;         // Write hits on shared lines
+    uint64_t coherence_misses; // Misses on lines another core invalidated
+    uint64_t false_sharing;    // ... where the bytes used were not written
+}core_stats_t;
+
+typedef struct coherence{
+    protocol_t protocol;
+    unsigned cores;
+    cache_t caches[MAX_CORES];
+    core_stats_t stats[MAX_CORES];
+    // Per core: blocks invalidated by another core, mapped to the byte
+    // mask that core wrote
+    addrmap_t invalidated[MAX_CORES];
+    // Block to number of false sharing misses on it
+    addrmap_t false_lines;
+    uint64_t invalidations, transfers, writebacks;
+}coherence_t;
+
+bool parseProtocol(const char *name, protocol_t *protocol);
+bool initCoherence(coherence_t *coh, protocol_t protocol, unsigned cores,
+                   unsigned set_len, uint64_t line_size, unsigned block_len);
+void freeCoherence(coherence_t *coh);
+
+result_t coherentAccess(coherence_t *coh, unsigned core, uint64_t addr, uint64_t size, bool write);
+// Hits, misses and evictions summed over all cores
+counters_t coherenceTotals(const coherence_t *coh);
+void printCoherenceStats(const coherence_t *coh);
+
+#endif /* CSIM_COHERENCE_H */
@@ -0,0 +1,191 @@
+/*
+ * corun.c - Co-run simulation of several traces in one shared cache
+ *
+ * Records of all traces are merged into one access stream: round-robin,
+ * by per-trace rate (trace i issues its k-th access at time k / rate_i),
+ * or by timestamps carried in the records. Every address is tagged with
+ * the index of its trace, so equal addresses of different traces do not
+ * share lines. The index stays out of the set index only under modulo
+ * indexing with fewer set and block bits than ASID_SHIFT, so co-runs
+ * refuse other geometries, as well as addresses reaching into its bits.
+ *
+ * Each trace is also replayed in a private cache of the same geometry,
+ * which gives its misses when running alone. The difference to its
+ * misses in the shared cache is the interference cost. A way mask per
+ * trace restricts which ways its fills may replace, like Intel CAT.
+ */
+#include "corun.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *interleave_names[] = {"rr", "rate", "time"};
+
+bool addCorunTrace(corun_t *run, const char *file){
+    if(run->count == MAX_TRACES) {
+        fprintf(stderr, "Error: At most %d traces can share a cache\n", MAX_TRACES);
+        return false;
+    }
+    corun_trace_t *trace = run->traces + run->count++;
+    memset(trace, 0, sizeof(corun_trace_t));
+    trace->file = file;
+    trace->rate = 1;
+    trace->way_mask = ~0UL;
+    return true;
+}
+
+bool parseInterleave(const char *name, interleave_t *mode){
+    for(size_t i = 0; i < sizeof(interleave_names) / sizeof(interleave_names[0]); i++) {
+        if(strcmp(name, interleave_names[i]) == 0) {
+            *mode = (interleave_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseCorunRates(corun_t *run, const char *list){
+    char *end;
+    for(unsigned i = 0; i < MAX_TRACES && *list; i++) {
+        double rate = strtod(list, &end);
+        if(end == list || rate <= 0) {
+            fprintf(stderr, "Error: Bad trace rate list '%s'\n", list);
+            return false;
+        }
+        // Rates may be given before the traces, store them all
+        run->traces[i].rate = rate;
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return true;
+}
+
+bool parseCorunMasks(corun_t *run, const char *list){
+    char *end;
+    for(unsigned i = 0; i < MAX_TRACES && *list; i++) {
+        uint64_t mask = strtoull(list, &end, 0);
+        if(end == list || !mask) {
+            fprintf(stderr, "Error: Bad way mask list '%s'\n", list);
+            return false;
+        }
+        run->traces[i].way_mask = mask;
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return true;
+}
+
+// Read ahead one record of trace i
+static void advance(corun_t *run, unsigned i){
+    corun_trace_t *trace = run->traces + i;
+    // Each access of a run line takes its own turn
+    if(trace->run_rec.run && trace->run_next < trace->run.count * trace->run.slots) {
+        expandRun(&(trace->run_rec), trace->run_next++, &(trace->next), trace->text);
+        return;
+    }
+    trace->live = nextRecord(&(trace->reader), &(trace->next));
+    if(trace->live && trace->next.run) {
+        trace->run = *trace->next.run;
+        trace->run_rec = trace->next;
+        trace->run_rec.run = &(trace->run);
+        trace->run_next = 0;
+        advance(run, i);
+    }
+    else if(trace->live) {
+        memcpy(trace->text, trace->reader.buf, BUFFER_SIZE);
+    }
+}
+
+bool startCorun(corun_t *run, const cache_t *shared){
+    if(shared->set_len + shared->block_len > ASID_SHIFT) {
+        fprintf(stderr, "Error: Co-runs need set and block bits below bit %d\n", ASID_SHIFT);
+        return false;
+    }
+    for(unsigned i = 0; i < run->count; i++) {
+        corun_trace_t *trace = run->traces + i;
+        if(shared->line_size <= MAX_MASKED_WAYS && !(trace->way_mask & shared->all_ways)) {
+            fprintf(stderr, "Error: Way mask of %s leaves no way of the cache\n", trace->file);
+            return false;
+        }
+        if(!openTrace(&(trace->reader), trace->file)) {
+            perror("Error: ");
+            return false;
+        }
+        if(!initCache(&(trace->alone), shared->set_len, shared->line_size, shared->block_len) ||
+           !setIndexFunction(&(trace->alone), &(shared->index))) {
+            return false;
+        }
+        advance(run, i);
+    }
+    return true;
+}
+
+void finishCorun(corun_t *run){
+    for(unsigned i = 0; i < run->count; i++) {
+        closeTrace(&(run->traces[i].reader));
+        freeCache(&(run->traces[i].alone));
+    }
+}
+
+int nextCorun(corun_t *run, trace_record_t *rec, const char **text){
+    int pick = -1;
+    for(unsigned k = 0; k < run->count; k++) {
+        unsigned i = (run->turn + k) % run->count;
+        corun_trace_t *trace = run->traces + i;
+        if(!trace->live) {
+            continue;
+        }
+        if(pick < 0) {
+            pick = i;
+            if(run->mode == INTERLEAVE_RR) {
+                break;
+            }
+            continue;
+        }
+        // Ties go to the trace whose turn comes first
+        if((run->mode == INTERLEAVE_RATE && trace->vtime < run->traces[pick].vtime) ||
+           (run->mode == INTERLEAVE_TIME && trace->next.time < run->traces[pick].next.time)) {
+            pick = i;
+        }
+    }
+    if(pick < 0) {
+        return -1;
+    }
+    corun_trace_t *trace = run->traces + pick;
+    *rec = trace->next;
+    if(rec->addr >> ASID_SHIFT) {
+        fprintf(stderr, "Error: Address %lx of %s overlaps the trace index bits\n", rec->addr, trace->file);
+        run->failed = true;
+        return -1;
+    }
+    rec->addr = asidAddr(pick, rec->addr);
+    // Reading ahead reuses the trace buffer, keep the text until next call
+    memcpy(run->text, trace->text, BUFFER_SIZE);
+    *text = run->text;
+    trace->vtime += 1 / trace->rate;
+    run->turn = pick + 1;
+    advance(run, pick);
+    return pick;
+}
+
+void recordCorun(corun_t *run, unsigned asid, const cache_t *shared, uint64_t addr, const result_t *ret){
+    corun_trace_t *trace = run->traces + asid;
+    countResult(&(trace->shared), ret);
+    if(ret->eviction) {
+        uint64_t owner = (ret->victim.tag << shared->block_len) >> ASID_SHIFT;
+        if(owner != asid && owner < run->count) {
+            run->traces[owner].stolen++;
+        }
+    }
+    accessCache(&(trace->alone), addr);
+}
+
+void printCorunStats(const corun_t *run){
+    for(unsigned i = 0; i < run->count; i++) {
+        const corun_trace_t *trace = run->traces + i;
+        int64_t extra = (int64_t)trace->shared.misses - (int64_t)trace->alone.miss_count;
+        printf("trace %u (%s): hits:%lu misses:%lu evictions:%lu alone-misses:%lu "
+               "interference:%+ld (%+.1f%%) stolen:%lu\n",
+               i, trace->file, trace->shared.hits, trace->shared.misses,
+               trace->shared.evictions, trace->alone.miss_count, extra,
+               trace->alone.miss_count ? 100.0 * extra / trace->alone.miss_count : 0.0,
+               trace->stolen);
+    }
+}
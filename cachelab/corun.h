@@ -0,0 +1,71 @@
+/*
+ * corun.h - Several traces sharing one cache
+ */
+#ifndef CSIM_CORUN_H
+#define CSIM_CORUN_H
+
+#include "cache.h"
+#include "trace.h"
+
+#define MAX_TRACES 16
+// Traces are kept apart by an address space id in the top address bits
+#define ASID_SHIFT 56
+
+typedef enum interleave{
+    INTERLEAVE_RR = 0,  // One access from each trace in turn
+    INTERLEAVE_RATE,    // Each trace issues at its own rate
+    INTERLEAVE_TIME     // Merge by record timestamps
+}interleave_t;
+
+typedef struct corun_trace{
+    const char *file;
+    trace_reader_t reader;
+    trace_record_t next;
+    char text[BUFFER_SIZE];
+    bool live;
+    // Run line being expanded, and its next access
+    trace_record_t run_rec;
+    trace_run_t run;
+    uint64_t run_next;
+    double rate;
+    double vtime;
+    uint64_t way_mask;
+    counters_t shared;
+    // Lines of this trace evicted by fills of other traces
+    uint64_t stolen;
+    // The same trace run alone in a private cache of the same geometry
+    cache_t alone;
+}corun_trace_t;
+
+typedef struct corun{
+    interleave_t mode;
+    unsigned count;
+    unsigned turn;
+    // Text of the record last returned by nextCorun()
+    char text[BUFFER_SIZE];
+    // Set when a record reached into the ASID bits and stopped the run
+    bool failed;
+    corun_trace_t traces[MAX_TRACES];
+}corun_t;
+
+static inline uint64_t asidAddr(unsigned asid, uint64_t addr){
+    return addr | ((uint64_t)asid << ASID_SHIFT);
+}
+
+bool addCorunTrace(corun_t *run, const char *file);
+bool parseInterleave(const char *name, interleave_t *mode);
+// Comma separated per-trace lists, in the order the traces were given
+bool parseCorunRates(corun_t *run, const char *list);
+bool parseCorunMasks(corun_t *run, const char *list);
+
+bool startCorun(corun_t *run, const cache_t *shared);
+void finishCorun(corun_t *run);
+
+// Pick the next record. Returns its trace index, or -1 when all are done
+// or a record's address overlaps the ASID bits (failed is set then).
+int nextCorun(corun_t *run, trace_record_t *rec, const char **text);
+// Account one access of trace asid to the shared cache and replay it alone
+void recordCorun(corun_t *run, unsigned asid, const cache_t *shared, uint64_t addr, const result_t *ret);
+void printCorunStats(const corun_t *run);
+
+#endif /* CSIM_CORUN_H */
@@ -1,118 +1,525 @@
 #include "cachelab.h"
-#include "list.h"
+#include "cache.h"
+#include "prefetch.h"
+#include "classify.h"
+#include "heatmap.h"
+#include "telemetry.h"
+#include "sample.h"
+#include "trace.h"
+#include "corun.h"
+#include "coherence.h"
+#include "spatial.h"
+#include "victim.h"
+#include "latency.h"
+#include "memo.h"
+#include "checkpoint.h"
+#include "fetch.h"
+#include "serve.h"
+#include "pagemap.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
 
-#define BUFFER_SIZE 64
+unsigned set_len = 0;
+uint64_t line_size = 0;
+unsigned block_len = 0;
+bool set_len_given = false, block_len_given = false;
 
-uint8_t set_len = 0;
-uint8_t line_size = 0;
-uint8_t block_len = 0;
-uint32_t hit_count = 0, miss_count = 0, eviction_count = 0;
+cache_t cache;
+prefetcher_t prefetcher;
+prefetch_config_t prefetch_config = {
+    .kind = PF_NONE,
+    .degree = 1,
+    .distance = 1,
+    .latency = 0,
+    .streams = 4
+};
+bool classify = false;
+classifier_t classifier;
+char *heatmap_file = NULL;
+heatmap_t heatmap;
+uint64_t interval_period = 0;
+double phase_threshold = 0;
+char *telemetry_file = NULL;
+telemetry_t telemetry;
+sample_config_t sample_config = {
+    .mode = SAMPLE_NONE,
+    .unit = 1000,
+    .warmup = 1000
+};
+sampler_t sampler;
+// Traces given with more than one -t share the cache
+corun_t corun;
+unsigned current_asid = 0;
+// More than one core switches to the coherent multi-core model
+unsigned cores = 1;
+protocol_t protocol = PROTOCOL_MESI;
+coherence_t coherence;
+unsigned current_core = 0;
+// Set by a record of a core beyond --cores, which ends the run
+bool core_overflow = false;
+index_config_t index_config = { .fn = INDEX_MODULO };
+// Split accesses at block boundaries, and track bytes used per line
+bool split = false;
+bool spatial_report = false;
+spatial_t spatial;
+// Entries of the victim or miss cache behind the main cache, 0 for none
+unsigned vbuffer_entries = 0;
+vbuffer_kind_t vbuffer_kind = VB_VICTIM;
+vbuffer_t vbuffer;
+// Cycle model, enabled by --latency
+bool latency_enabled = false;
+latency_config_t latency_config = { .mshrs = 8, .bytes_per_cycle = 8, .clock_ghz = 3.0 };
+bool victim_latency_given = false;
+latency_model_t latency;
+// Store of finished runs, from --memo-dir or CSIM_MEMO_DIR
+const char *memo_dir = NULL;
+// Worker threads decoding the trace, 0 reads it sequentially
+unsigned parse_threads = 0;
+// Marker file bounding the region of the trace to simulate
+const char *marker_file = NULL;
+// Report parse and simulate time, throughput and peak RSS on stderr
+bool timing = false;
+double parse_seconds = 0, simulate_seconds = 0;
+// Records read ahead per batch when timing the two stages apart
+#define TIMING_BATCH 4096
+// Checkpoints and trace slices. position counts records read so far;
+// those before start_at are skipped, and reading ends at stop_at.
+const char *checkpoint_file = NULL;
+const char *restore_file = NULL;
+uint64_t checkpoint_at = 0, checkpoint_every = 0;
+bool checkpoint_at_given = false;
+uint64_t start_at = 0, stop_at = ~0UL;
+bool start_given = false, reset_counters = false;
+uint64_t position = 0;
+// Simulate run lines in bulk, set when no per-access model is enabled
+bool bulk_runs = false;
+// Instruction fetch model, enabled by --icache or --unified
+bool fetch_enabled = false;
+fetch_config_t fetch_config;
+fetch_model_t fetch;
+// Socket of the resident daemon, and the workers answering its queries
+const char *serve_socket = NULL;
+unsigned serve_workers = SERVE_DEFAULT_WORKERS;
+// Virtual to physical translation, enabled by --frames, and the miss
+// counts of every frame policy side by side with --compare-frames
+bool paging = false, compare_frames = false;
+page_config_t page_config = { .page_size = DEFAULT_PAGE_SIZE, .policy = FRAME_IDENTITY, .seed = 1 };
+page_map_t page_map;
+page_compare_t page_compare;
 
-typedef struct line{
-    uint64_t tag;
-    struct list_head list;
-}line_t;
+// Long options have no short form, so they get values above the char range
+enum {
+    OPT_PREFETCH = 256,
+    OPT_PF_DEGREE,
+    OPT_PF_DISTANCE,
+    OPT_PF_LATENCY,
+    OPT_PF_STREAMS,
+    OPT_3C,
+    OPT_HEATMAP,
+    OPT_REGION,
+    OPT_REGION_FILE,
+    OPT_INTERVAL,
+    OPT_TELEMETRY,
+    OPT_PHASE_THRESHOLD,
+    OPT_SAMPLE_SETS,
+    OPT_SAMPLE_PERIOD,
+    OPT_SAMPLE_UNIT,
+    OPT_SAMPLE_WARMUP,
+    OPT_INTERLEAVE,
+    OPT_RATES,
+    OPT_WAY_MASKS,
+    OPT_CORES,
+    OPT_COHERENCE,
+    OPT_INDEX,
+    OPT_INDEX_MATRIX,
+    OPT_SKEWED,
+    OPT_SPLIT,
+    OPT_SPATIAL,
+    OPT_VICTIM_CACHE,
+    OPT_MISS_CACHE,
+    OPT_LATENCY,
+    OPT_VICTIM_LATENCY,
+    OPT_MSHRS,
+    OPT_DRAM_BANDWIDTH,
+    OPT_CLOCK_GHZ,
+    OPT_MEMO_DIR,
+    OPT_PARSE_THREADS,
+    OPT_MARKERS,
+    OPT_TIMING,
+    OPT_SAVE_CHECKPOINT,
+    OPT_CHECKPOINT_AT,
+    OPT_CHECKPOINT_EVERY,
+    OPT_LOAD_CHECKPOINT,
+    OPT_START,
+    OPT_STOP,
+    OPT_RESET_COUNTERS,
+    OPT_ICACHE,
+    OPT_UNIFIED,
+    OPT_L2,
+    OPT_SERVE,
+    OPT_WORKERS,
+    OPT_FRAMES,
+    OPT_PAGE_SIZE,
+    OPT_FRAME_SEED,
+    OPT_COMPARE_FRAMES
+};
 
-typedef struct set{
-    size_t size;
-    struct list_head line_head;
-}set_t;
+static const char short_options[] = "hvs:E:b:t:";
+// Options reading an input file, keyed by its content when memoizing
+static const char *file_options[] = { "t", "region-file", "markers", NULL };
 
-typedef struct result{
-    bool miss;
-    bool hit;
-    bool eviction;
-}result_t;
+static const struct option long_options[] = {
+    {"prefetch",    required_argument, NULL, OPT_PREFETCH},
+    {"pf-degree",   required_argument, NULL, OPT_PF_DEGREE},
+    {"pf-distance", required_argument, NULL, OPT_PF_DISTANCE},
+    {"pf-latency",  required_argument, NULL, OPT_PF_LATENCY},
+    {"pf-streams",  required_argument, NULL, OPT_PF_STREAMS},
+    {"3c",          no_argument,       NULL, OPT_3C},
+    {"heatmap",     required_argument, NULL, OPT_HEATMAP},
+    {"region",      required_argument, NULL, OPT_REGION},
+    {"region-file", required_argument, NULL, OPT_REGION_FILE},
+    {"interval",    required_argument, NULL, OPT_INTERVAL},
+    {"telemetry",   required_argument, NULL, OPT_TELEMETRY},
+    {"phase-threshold", required_argument, NULL, OPT_PHASE_THRESHOLD},
+    {"sample-sets",   required_argument, NULL, OPT_SAMPLE_SETS},
+    {"sample-period", required_argument, NULL, OPT_SAMPLE_PERIOD},
+    {"sample-unit",   required_argument, NULL, OPT_SAMPLE_UNIT},
+    {"sample-warmup", required_argument, NULL, OPT_SAMPLE_WARMUP},
+    {"interleave",    required_argument, NULL, OPT_INTERLEAVE},
+    {"rates",         required_argument, NULL, OPT_RATES},
+    {"way-masks",     required_argument, NULL, OPT_WAY_MASKS},
+    {"cores",         required_argument, NULL, OPT_CORES},
+    {"coherence",     required_argument, NULL, OPT_COHERENCE},
+    {"index",         required_argument, NULL, OPT_INDEX},
+    {"index-matrix",  required_argument, NULL, OPT_INDEX_MATRIX},
+    {"skewed",        no_argument,       NULL, OPT_SKEWED},
+    {"split",         no_argument,       NULL, OPT_SPLIT},
+    {"spatial",       no_argument,       NULL, OPT_SPATIAL},
+    {"victim-cache",  required_argument, NULL, OPT_VICTIM_CACHE},
+    {"miss-cache",    required_argument, NULL, OPT_MISS_CACHE},
+    {"latency",       required_argument, NULL, OPT_LATENCY},
+    {"victim-latency", required_argument, NULL, OPT_VICTIM_LATENCY},
+    {"mshrs",         required_argument, NULL, OPT_MSHRS},
+    {"dram-bandwidth", required_argument, NULL, OPT_DRAM_BANDWIDTH},
+    {"clock-ghz",     required_argument, NULL, OPT_CLOCK_GHZ},
+    {"memo-dir",      required_argument, NULL, OPT_MEMO_DIR},
+    {"parse-threads", required_argument, NULL, OPT_PARSE_THREADS},
+    {"markers",       required_argument, NULL, OPT_MARKERS},
+    {"timing",        no_argument,       NULL, OPT_TIMING},
+    {"save-checkpoint", required_argument, NULL, OPT_SAVE_CHECKPOINT},
+    {"checkpoint-at", required_argument, NULL, OPT_CHECKPOINT_AT},
+    {"checkpoint-every", required_argument, NULL, OPT_CHECKPOINT_EVERY},
+    {"load-checkpoint", required_argument, NULL, OPT_LOAD_CHECKPOINT},
+    {"start",         required_argument, NULL, OPT_START},
+    {"stop",          required_argument, NULL, OPT_STOP},
+    {"reset-counters", no_argument,      NULL, OPT_RESET_COUNTERS},
+    {"icache",        required_argument, NULL, OPT_ICACHE},
+    {"unified",       no_argument,       NULL, OPT_UNIFIED},
+    {"l2",            required_argument, NULL, OPT_L2},
+    {"serve",         required_argument, NULL, OPT_SERVE},
+    {"workers",       required_argument, NULL, OPT_WORKERS},
+    {"frames",        required_argument, NULL, OPT_FRAMES},
+    {"page-size",     required_argument, NULL, OPT_PAGE_SIZE},
+    {"frame-seed",    required_argument, NULL, OPT_FRAME_SEED},
+    {"compare-frames", no_argument,      NULL, OPT_COMPARE_FRAMES},
+    {NULL, 0, NULL, 0}
+};
 
-static inline void list_pop(struct list_head *head) {
-	if(!list_empty(head)) {
-        line_t *popped = list_entry(head->next, line_t, list);
-        list_del(head->next);
-        free(popped);
+result_t access(uint64_t addr, uint64_t size, bool write){
+    result_t ret;
+    bool measure = true;
+    if(compare_frames) {
+        recordPageCompare(&page_compare, current_asid, addr);
+    }
+    // Every model below sees physical addresses
+    if(paging) {
+        addr = translate(&page_map, current_asid, addr);
+    }
+    if(cores > 1) {
+        return coherentAccess(&coherence, current_core, addr, size, write);
+    }
+    if(sample_config.mode != SAMPLE_NONE && !sampleAccess(&sampler, &cache, addr, &measure)) {
+        return (result_t){ 0 };
+    }
+    if(prefetch_config.kind != PF_NONE) {
+        ret = prefetchAccess(&prefetcher, &cache, addr);
+    }
+    else {
+        ret = accessCache(&cache, addr);
+    }
+    if(classify) {
+        classifyAccess(&classifier, getTag(&cache, addr), ret.miss);
+    }
+    if(heatmap.set_count) {
+        recordHeatmap(&heatmap, &cache, addr, &ret);
+    }
+    if(interval_period) {
+        recordTelemetry(&telemetry, getTag(&cache, addr), &ret);
     }
+    if(sample_config.mode != SAMPLE_NONE && measure) {
+        recordSample(&sampler, &cache, addr, &ret);
+    }
+    if(corun.count > 1) {
+        recordCorun(&corun, current_asid, &cache, addr, &ret);
+    }
+    if(spatial_report) {
+        recordSpatial(&spatial, &cache, addr, size, &ret);
+    }
+    bool absorbed = false;
+    if(vbuffer_entries) {
+        absorbed = recordVictimBuffer(&vbuffer, &cache, addr, &ret);
+    }
+    if(latency_enabled) {
+        recordLatency(&latency, getTag(&cache, addr), &ret, absorbed);
+    }
+    if(fetch_enabled) {
+        recordDataAccess(&fetch, addr, &ret, absorbed);
+    }
+    if(write && (checkpoint_file || restore_file)) {
+        markDirty(&cache, addr);
+    }
+    return ret;
+}
+
+result_t load(uint64_t addr, uint64_t size){
+    return access(addr, size, false);
 }
 
-void freeLineList(struct list_head *head) {
-    struct list_head *listptr, *tmp;
-    line_t *entry;
-    list_for_each_safe(listptr, tmp, head) {
-        entry = list_entry(listptr, line_t, list);
-        list_del(listptr);
-        free(entry);
+//modify need to call load and store
+result_t store(uint64_t addr, uint64_t size){
+    return access(addr, size, true);
+}
+
+static void printResult(result_t ret){
+    if(ret.miss) {
+        printf(" miss");
+    }
+    else if(ret.hit) {
+        printf(" hit");
+    }
+    if(ret.eviction) {
+        printf(" eviction");
     }
 }
 
-line_t* searchCache(set_t *set, uint64_t tag){
-    line_t *entry;
-    list_for_each_entry(entry, &(set->line_head), list) {
-        if(entry->tag == tag) {
-            return entry;
+/*
+ * accessRange - Load or store size bytes at addr. With --split an access
+ *               crossing block boundaries touches every block it covers;
+ *               the results of all but the last block are printed here.
+ */
+static result_t accessRange(uint64_t addr, uint64_t size, bool write, bool verbose){
+    if(split && size > 1) {
+        uint64_t last = (addr + size - 1) >> block_len;
+        for(uint64_t block = addr >> block_len; block < last; block++) {
+            uint64_t next = (block + 1) << block_len;
+            result_t ret = write ? store(addr, next - addr) : load(addr, next - addr);
+            if(verbose) {
+                printResult(ret);
+            }
+            size -= next - addr;
+            addr = next;
         }
     }
-    return NULL;
+    return write ? store(addr, size) : load(addr, size);
 }
 
-bool addLine(set_t *set, uint64_t tag){
-    line_t* new_cache = (line_t*)calloc(1, sizeof(line_t));
-    new_cache->tag = tag;
+static void simulateRecord(const trace_record_t *rec, const char *text, bool verbose);
 
-    //add to back of the list
-    list_add_tail(&(new_cache->list), &(set->line_head));
-    (set->size)++;
-
-    //check valid cache
-    if(set->size <= line_size){
-        return false; //no eviction
+/*
+ * simulateRun - Simulate a run line. After each iteration done access by
+ *               access, if every block it touched is still cached, the
+ *               iterations that stay within those blocks all hit and leave
+ *               the LRU order as it is, so they are only counted.
+ */
+static void simulateRun(const trace_record_t *rec){
+    const trace_run_t *run = rec->run;
+    uint64_t block_mask = (1UL << block_len) - 1;
+    uint64_t accesses = 0;
+    for(unsigned i = 0; i < run->slots; i++) {
+        accesses += (run->slot[i].op == 'M') ? 2 : 1;
     }
-    else {
-        // Delete first entry, since our list is in time order
-        // First Entry would be the longest not used line
-        list_pop(&(set->line_head));
-        (set->size)--;
-        return true;
+    for(uint64_t done = 0; done < run->count;) {
+        for(unsigned i = 0; i < run->slots; i++) {
+            trace_record_t access;
+            expandRun(rec, done * run->slots + i, &access, NULL);
+            simulateRecord(&access, NULL, false);
+        }
+        done++;
+        uint64_t skip = run->count - done;
+        for(unsigned i = 0; i < run->slots && skip; i++) {
+            const run_slot_t *slot = run->slot + i;
+            uint64_t addr = slot->addr + (uint64_t)slot->stride * (done - 1);
+            uint64_t tag = getTag(&cache, addr), offset = addr & block_mask;
+            if(!findLine(&cache, getSet(&cache, tag), tag)) {
+                skip = 0;
+            }
+            else if(slot->stride > 0 && (block_mask - offset) / slot->stride < skip) {
+                skip = (block_mask - offset) / slot->stride;
+            }
+            else if(slot->stride < 0 && offset / -(uint64_t)slot->stride < skip) {
+                skip = offset / -(uint64_t)slot->stride;
+            }
+        }
+        cache.hit_count += skip * accesses;
+        cache.now += skip * accesses;
+        done += skip;
     }
 }
 
-static inline uint64_t getTag(uint64_t addr){
-    return addr >> block_len;
+static void simulateRecord(const trace_record_t *rec, const char *text, bool verbose){
+    result_t ret = { 0 };
+    if(rec->run && bulk_runs) {
+        simulateRun(rec);
+        return;
+    }
+    if(rec->run) {
+        for(uint64_t i = 0; i < rec->run->count * rec->run->slots; i++) {
+            trace_record_t access;
+            char access_text[BUFFER_SIZE];
+            expandRun(rec, i, &access, verbose ? access_text : NULL);
+            simulateRecord(&access, access_text, verbose);
+        }
+        return;
+    }
+    current_core = rec->core;
+    if(verbose) {
+        if(corun.count > 1) {
+            printf("%u:", current_asid);
+        }
+        // Data lines start with a space, instruction fetches with the I
+        printf("%s", rec->op == 'I' ? text : text+1);
+    }
+    switch (rec->op) {
+        case 'I': {
+            uint64_t addr = paging ? translate(&page_map, current_asid, rec->addr) : rec->addr;
+            ret = fetchInstruction(&fetch, &cache, addr);
+            break;
+        }
+        case 'L': {
+            ret = accessRange(rec->addr, rec->size, false, verbose);
+            break;
+        }
+        case 'S': {
+            ret = accessRange(rec->addr, rec->size, true, verbose);
+            break;
+        }
+        case 'M': {
+            ret = accessRange(rec->addr, rec->size, false, verbose);
+            if(verbose) {
+                printResult(ret);
+            }
+            ret = accessRange(rec->addr, rec->size, true, verbose);
+            break;
+        }
+        default:
+            break;
+    }
+    if(verbose) {
+        printResult(ret);
+        puts("");
+    }
 }
 
-result_t access(set_t *set, uint64_t tag){
-    result_t ret = {false, false, false};
-    line_t *ret_cache;
-    // Search if the line is in cache
-    if((ret_cache = searchCache(set, tag)) != NULL){
-        // Line Linklist is ordered in used time 
-        // Recently used line would be put to the end
-        list_move_tail(&(ret_cache->list), &(set->line_head));
-        ret.hit = true;
-        hit_count++;
-    }
-    else {
-        ret.miss = true;
-        miss_count++;
-        // addLine() return true if there's eviction happened
-        if(addLine(set, tag)){
-            ret.eviction = true;
-            eviction_count++;
+/*
+ * runRecord - Simulate the record at the current position unless it lies
+ *             before the slice, writing checkpoints on the way. Returns
+ *             false once the slice has ended.
+ */
+static bool runRecord(const trace_record_t *rec, const char *text, bool verbose){
+    // Slices and checkpoints fall between the accesses of a run
+    if(rec->run && !bulk_runs) {
+        for(uint64_t i = 0; i < rec->run->count * rec->run->slots; i++) {
+            trace_record_t access;
+            char access_text[BUFFER_SIZE];
+            expandRun(rec, i, &access, verbose ? access_text : NULL);
+            if(!runRecord(&access, access_text, verbose)) {
+                return false;
+            }
         }
+        return true;
     }
-    return ret;
+    if(position >= stop_at) {
+        return false;
+    }
+    if(cores > 1 && rec->core >= cores) {
+        current_core = rec->core;
+        core_overflow = true;
+        return false;
+    }
+    // Before the slice the cache holds the state at start_at, not position
+    bool started = position >= start_at;
+    if(started && checkpoint_file && checkpoint_every && position && position % checkpoint_every == 0) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s.%lu", checkpoint_file, position);
+        saveCheckpoint(&cache, position, path);
+    }
+    else if(started && checkpoint_file && checkpoint_at_given && position == checkpoint_at) {
+        saveCheckpoint(&cache, position, checkpoint_file);
+    }
+    position++;
+    if(started) {
+        simulateRecord(rec, text, verbose);
+    }
+    return true;
 }
 
-result_t load(set_t *set, uint64_t tag){
-    return access(set, tag);
+static double secondsSince(const struct timespec *start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
 }
 
-//modify need to call load and store
-result_t store(set_t *set, uint64_t tag){
-    return access(set, tag);
+/*
+ * simulateTimed - Alternate between reading a batch of records and
+ *                 simulating it, timing each stage.
+ */
+static uint64_t simulateTimed(trace_reader_t *reader, bool verbose){
+    static trace_record_t recs[TIMING_BATCH];
+    static char texts[TIMING_BATCH][BUFFER_SIZE];
+    uint64_t total = 0;
+    size_t count;
+    bool more = true;
+    do {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        // The reader keeps a single run, so a run line ends the batch
+        for(count = 0; count < TIMING_BATCH && (more = nextRecord(reader, recs + count));) {
+            if(verbose) {
+                memcpy(texts[count], reader->buf, BUFFER_SIZE);
+            }
+            if(recs[count++].run) {
+                break;
+            }
+        }
+        parse_seconds += secondsSince(&start);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(size_t i = 0; i < count; i++) {
+            if(!runRecord(recs + i, texts[i], verbose)) {
+                count = i;
+                more = false;
+                break;
+            }
+        }
+        simulate_seconds += secondsSince(&start);
+        total += count;
+    } while(more);
+    return total;
+}
+
+static void printTiming(uint64_t records){
+    struct rusage usage;
+    double seconds = parse_seconds + simulate_seconds;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "timing: records:%lu parse:%.3fs simulate:%.3fs rate:%.0f/s peak-rss:%ldKB\n",
+            records, parse_seconds, simulate_seconds, seconds > 0 ? records / seconds : 0,
+            usage.ru_maxrss);
 }
 
 void printHelp(char* name) {
@@ -120,22 +527,78 @@ void printHelp(char* name) {
     puts("Options:");
     puts("  -h         Print this help message.");
     puts("  -v         Optional verbose flag.");
-    puts("  -s <num>   Number of set index bits.");
+    puts("  -s <num>   Number of set index bits (0 is fully associative).");
     puts("  -E <num>   Number of lines per set.");
     puts("  -b <num>   Number of block offset bits.");
-    puts("  -t <file>  Trace file.\n");
+    puts("  -t <file>  Trace file, give several to share the cache between them.");
+    puts("  --prefetch <kind>     Prefetcher: none, next-line, stride or stream.");
+    puts("  --pf-degree <num>     Blocks prefetched per trigger (default 1).");
+    puts("  --pf-distance <num>   Blocks ahead of the trigger (default 1).");
+    puts("  --pf-latency <num>    Prefetch fill latency in accesses (default 0).");
+    puts("  --pf-streams <num>    Number of stream buffers (default 4).");
+    puts("  --3c                  Classify misses as compulsory, capacity or conflict.");
+    puts("  --heatmap <file>      Write per-set and per-region counters (CSV or .json).");
+    puts("  --region <n:lo:hi>    Count accesses to hex address range [lo, hi) as n.");
+    puts("  --region-file <file>  Read 'name lo hi' regions, e.g. .regions from tracegen.");
+    puts("  --interval <num>      Emit statistics every <num> accesses.");
+    puts("  --telemetry <file>    Write interval statistics to <file> (default stdout).");
+    puts("  --phase-threshold <x> Flag a phase change when the miss ratio or footprint");
+    puts("                        of an interval moves by more than x of the phase mean.");
+    puts("  --sample-sets <num>   Simulate about one set in <num> and extrapolate.");
+    puts("  --sample-period <num> Simulate one unit every <num> accesses and extrapolate.");
+    puts("  --sample-unit <num>   Measured accesses per unit (default 1000).");
+    puts("  --sample-warmup <num> Unmeasured warm-up accesses before a unit (default 1000).");
+    puts("  --interleave <mode>   Merge several traces by rr, rate or time (default rr).");
+    puts("  --rates <r0,r1,...>   Relative access rate of each trace for rate mode.");
+    puts("  --way-masks <m0,...>  Ways each trace may fill in the shared cache.");
+    puts("  --cores <num>         Give each core (t<id> trace field) a private cache.");
+    puts("  --coherence <proto>   Keep core caches coherent with mesi or moesi.");
+    puts("  --index <fn>          Set index function: modulo, xor or prime.");
+    puts("  --index-matrix <rows> Index bit i is the parity of the block number and row i.");
+    puts("  --skewed              Hash each way differently (skewed-associative).");
+    puts("  --split               Split accesses into every block they cover.");
+    puts("  --spatial             Report bytes used per fetched line before eviction.");
+    puts("  --victim-cache <num>  Fully-associative victim cache of num lines.");
+    puts("  --miss-cache <num>    Fully-associative miss cache of num lines.");
+    puts("  --latency <hit,mem>   Estimate cycles from hit and memory latencies.");
+    puts("  --victim-latency <n>  Cycles of a victim/miss cache hit (default hit+2).");
+    puts("  --mshrs <num>         Misses outstanding at once (default 8).");
+    puts("  --dram-bandwidth <n>  DRAM channel bytes per cycle (default 8).");
+    puts("  --clock-ghz <f>       Clock used to report bandwidth (default 3.0).");
+    puts("  --memo-dir <dir>      Reuse and store results of identical runs in dir.");
+    puts("  --parse-threads <num> Decode the trace with num worker threads.");
+    puts("  --markers <file>      Simulate only the region between tracegen's markers.");
+    puts("  --timing              Report parse/simulate time and peak RSS on stderr.");
+    puts("  --save-checkpoint <f> Write the cache state to f at the end of the run,");
+    puts("  --checkpoint-at <n>   after n records instead,");
+    puts("  --checkpoint-every <n> or to f.<records> every n records.");
+    puts("  --load-checkpoint <f> Start from the cache state in f, at its offset.");
+    puts("  --start <n>           Skip the records before n.");
+    puts("  --stop <n>            Stop reading at record n.");
+    puts("  --reset-counters      Count only the accesses after the checkpoint.");
+    puts("  --icache <s,E,b>      Simulate the I lines in a split L1 instruction cache,");
+    puts("  --unified             or in the main cache, shared with the data.");
+    puts("  --l2 <s,E,b>          Shared L2 behind the L1s, looked up on their misses.");
+    puts("  --serve <socket>      Decode the trace once and answer queries on a Unix socket;");
+    puts("                        -s, -E, -b, --index and --prefetch become query defaults.");
+    puts("  --workers <num>       Threads answering daemon queries (default 4).");
+    puts("  --frames <policy>     Map pages to frames: identity, sequential, random or colour.");
+    puts("  --page-size <bytes>   Page size of the mapping (default 4096).");
+    puts("  --frame-seed <num>    Seed of the random frame policy (default 1).");
+    puts("  --compare-frames      Report the misses of every frame policy side by side.");
+    puts("  Give '-t -' to read the trace from stdin, e.g. piped from valgrind.\n");
 
     puts("Examples:");
     printf("  linux>  %s -s 4 -E 1 -b 4 -t traces/yi.trace\n", name);
     printf("  linux>  %s -v -s 8 -E 2 -b 4 -t traces/yi.trace\n", name);
+    printf("  linux>  %s -s 5 -E 1 -b 5 --prefetch stride --pf-degree 2 -t traces/long.trace\n", name);
 }
 
 int main(int argc, char *argv[])
 {
-    char ch;
-    char *trace_file = NULL;
+    int ch;
     bool verbose = false;
-    while((ch = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+    while((ch = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
         switch(ch) {
             case 'h': {
                 printHelp(argv[0]);
@@ -146,117 +609,617 @@ int main(int argc, char *argv[])
                 break;
             }
             case 's': {
-                set_len = (uint8_t)atoi(optarg);
+                set_len = (unsigned)atoi(optarg);
+                set_len_given = true;
                 break;
             }
             case 'E': {
-                line_size = (uint8_t)atoi(optarg);
+                line_size = strtoull(optarg, NULL, 0);
                 break;
             }
             case 'b': {
-                block_len = (uint8_t)atoi(optarg);
+                block_len = (unsigned)atoi(optarg);
+                block_len_given = true;
                 break;
             }
             case 't': {
-                trace_file = strdup(optarg);
+                if(!addCorunTrace(&corun, optarg)) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_PREFETCH: {
+                if(!parsePrefetchKind(optarg, &(prefetch_config.kind))) {
+                    fprintf(stderr, "%s: Unknown prefetcher '%s'\n", argv[0], optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_PF_DEGREE: {
+                prefetch_config.degree = (unsigned)atoi(optarg);
+                break;
+            }
+            case OPT_PF_DISTANCE: {
+                prefetch_config.distance = (unsigned)atoi(optarg);
+                break;
+            }
+            case OPT_PF_LATENCY: {
+                prefetch_config.latency = (unsigned)atoi(optarg);
+                break;
+            }
+            case OPT_PF_STREAMS: {
+                prefetch_config.streams = (unsigned)atoi(optarg);
+                break;
+            }
+            case OPT_3C: {
+                classify = true;
+                break;
+            }
+            case OPT_HEATMAP: {
+                heatmap_file = optarg;
+                break;
+            }
+            case OPT_REGION: {
+                if(!addRegion(&heatmap, optarg)) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_REGION_FILE: {
+                if(!loadRegions(&heatmap, optarg)) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_INTERVAL: {
+                interval_period = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_TELEMETRY: {
+                telemetry_file = optarg;
+                break;
+            }
+            case OPT_PHASE_THRESHOLD: {
+                phase_threshold = atof(optarg);
+                break;
+            }
+            case OPT_SAMPLE_SETS: {
+                sample_config.mode = SAMPLE_SETS;
+                sample_config.set_ratio = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_SAMPLE_PERIOD: {
+                sample_config.mode = SAMPLE_TIME;
+                sample_config.period = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_SAMPLE_UNIT: {
+                sample_config.unit = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_SAMPLE_WARMUP: {
+                sample_config.warmup = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_INTERLEAVE: {
+                if(!parseInterleave(optarg, &(corun.mode))) {
+                    fprintf(stderr, "%s: Unknown interleave mode '%s'\n", argv[0], optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_RATES: {
+                if(!parseCorunRates(&corun, optarg)) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_WAY_MASKS: {
+                if(!parseCorunMasks(&corun, optarg)) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_CORES: {
+                cores = (unsigned)atoi(optarg);
+                break;
+            }
+            case OPT_COHERENCE: {
+                if(!parseProtocol(optarg, &protocol)) {
+                    fprintf(stderr, "%s: Unknown coherence protocol '%s'\n", argv[0], optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_INDEX: {
+                if(!parseIndexFunction(optarg, &(index_config.fn))) {
+                    fprintf(stderr, "%s: Unknown index function '%s'\n", argv[0], optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_INDEX_MATRIX: {
+                if(!parseIndexMatrix(optarg, &index_config)) {
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_SKEWED: {
+                index_config.skewed = true;
+                break;
+            }
+            case OPT_SPLIT: {
+                split = true;
+                break;
+            }
+            case OPT_SPATIAL: {
+                spatial_report = true;
+                break;
+            }
+            case OPT_LATENCY: {
+                if(!parseLatency(optarg, &latency_config)) {
+                    return EXIT_FAILURE;
+                }
+                latency_enabled = true;
+                break;
+            }
+            case OPT_VICTIM_LATENCY: {
+                latency_config.victim = (unsigned)atoi(optarg);
+                victim_latency_given = true;
+                break;
+            }
+            case OPT_MSHRS: {
+                latency_config.mshrs = (unsigned)atoi(optarg);
+                break;
+            }
+            case OPT_DRAM_BANDWIDTH: {
+                latency_config.bytes_per_cycle = atof(optarg);
+                break;
+            }
+            case OPT_CLOCK_GHZ: {
+                latency_config.clock_ghz = atof(optarg);
+                break;
+            }
+            case OPT_MEMO_DIR: {
+                memo_dir = optarg;
+                break;
+            }
+            case OPT_PARSE_THREADS: {
+                parse_threads = (unsigned)atoi(optarg);
+                break;
+            }
+            case OPT_MARKERS: {
+                marker_file = optarg;
+                break;
+            }
+            case OPT_TIMING: {
+                timing = true;
+                break;
+            }
+            case OPT_SAVE_CHECKPOINT: {
+                checkpoint_file = optarg;
+                break;
+            }
+            case OPT_CHECKPOINT_AT: {
+                checkpoint_at = strtoull(optarg, NULL, 0);
+                checkpoint_at_given = true;
+                break;
+            }
+            case OPT_CHECKPOINT_EVERY: {
+                checkpoint_every = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_LOAD_CHECKPOINT: {
+                restore_file = optarg;
+                break;
+            }
+            case OPT_START: {
+                start_at = strtoull(optarg, NULL, 0);
+                start_given = true;
+                break;
+            }
+            case OPT_STOP: {
+                stop_at = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_RESET_COUNTERS: {
+                reset_counters = true;
+                break;
+            }
+            case OPT_ICACHE: {
+                if(!parseGeometry(optarg, &(fetch_config.icache))) {
+                    return EXIT_FAILURE;
+                }
+                fetch_enabled = true;
+                break;
+            }
+            case OPT_UNIFIED: {
+                fetch_config.unified = true;
+                fetch_enabled = true;
+                break;
+            }
+            case OPT_SERVE: {
+                serve_socket = optarg;
+                break;
+            }
+            case OPT_WORKERS: {
+                serve_workers = (unsigned)atoi(optarg);
+                if(!serve_workers) {
+                    fprintf(stderr, "%s: The daemon needs at least one worker\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_FRAMES: {
+                if(!parseFramePolicy(optarg, &(page_config.policy))) {
+                    fprintf(stderr, "%s: Unknown frame policy '%s'\n", argv[0], optarg);
+                    return EXIT_FAILURE;
+                }
+                paging = true;
+                break;
+            }
+            case OPT_PAGE_SIZE: {
+                page_config.page_size = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_FRAME_SEED: {
+                page_config.seed = strtoull(optarg, NULL, 0);
+                break;
+            }
+            case OPT_COMPARE_FRAMES: {
+                compare_frames = true;
+                break;
+            }
+            case OPT_L2: {
+                if(!parseGeometry(optarg, &(fetch_config.l2_geometry))) {
+                    return EXIT_FAILURE;
+                }
+                fetch_config.l2 = true;
+                break;
+            }
+            case OPT_VICTIM_CACHE:
+            case OPT_MISS_CACHE: {
+                vbuffer_kind = (ch == OPT_VICTIM_CACHE) ? VB_VICTIM : VB_MISS;
+                vbuffer_entries = (unsigned)atoi(optarg);
+                if(!vbuffer_entries) {
+                    fprintf(stderr, "%s: Victim/miss cache needs at least one entry\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
                 break;
             }
             default:
                 break;
         }
     }
-    // If anything of the following be 0, the simulator won't work
-    if(!(set_len) || !(line_size) || !(block_len) || !(trace_file)) {
+    // The daemon takes its geometry from each query, the options are defaults
+    if(serve_socket) {
+        serve_query_t defaults = {
+            .set_len = set_len, .line_size = line_size, .block_len = block_len,
+            .set_len_given = set_len_given, .line_size_given = line_size != 0,
+            .block_len_given = block_len_given, .index = index_config.fn,
+            .prefetch = prefetch_config, .lo = 0, .hi = ~0UL
+        };
+        packed_trace_t trace;
+        if(corun.count != 1) {
+            fprintf(stderr, "%s: The daemon serves exactly one trace\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        // Queries only choose the geometry, index function, prefetcher and region
+        if(verbose || classify || heatmap_file || heatmap.region_count || interval_period ||
+           telemetry_file || sample_config.mode != SAMPLE_NONE || corun.traces[0].way_mask != ~0UL ||
+           cores > 1 || index_config.fn == INDEX_MATRIX || index_config.skewed || split || spatial_report ||
+           vbuffer_entries || latency_enabled || checkpoint_file || restore_file || start_given ||
+           stop_at != ~0UL || fetch_enabled || fetch_config.l2 || paging || compare_frames || timing) {
+            fprintf(stderr, "%s: The daemon supports only -s, -E, -b, --index modulo/xor/prime, "
+                    "prefetching and --markers\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(!loadPackedTrace(&trace, corun.traces[0].file, parse_threads, marker_file)) {
+            return EXIT_FAILURE;
+        }
+        bool served = serveTrace(&trace, &defaults, serve_socket, serve_workers);
+        freePackedTrace(&trace);
+        return served ? 0 : EXIT_FAILURE;
+    }
+    // s=0 (fully associative) and b=0 are valid once given explicitly
+    if(!(set_len_given) || !(line_size) || !(block_len_given) || !(corun.count)) {
         fprintf(stderr, "%s: Missing required command line argument\n", argv[0]);
         printHelp(argv[0]);
         return EXIT_FAILURE;
     }
 
-    FILE *fptr;
-    if(!(fptr = fopen(trace_file, "r"))) {
+    // Runs that write more than stdout or depend on checkpoints are always
+    // simulated; traces, region and marker files are keyed by content
+    memo_t memo;
+    bool memoize = false;
+    if(!memo_dir) {
+        memo_dir = getenv(MEMO_DIR_ENV);
+    }
+    if(memo_dir && !verbose && !heatmap_file && !telemetry_file && !checkpoint_file && !restore_file) {
+        memoize = initMemo(&memo, memo_dir, argc, argv, short_options, long_options, file_options);
+        if(memoize && replayMemo(&memo)) {
+            return 0;
+        }
+    }
+
+    if(!initCache(&cache, set_len, line_size, block_len) || !setIndexFunction(&cache, &index_config)) {
+        return EXIT_FAILURE;
+    }
+    // Skewed caches have no sets for these models to work on
+    if(index_config.skewed && (cores > 1 || prefetch_config.kind != PF_NONE || sample_config.mode == SAMPLE_SETS)) {
+        fprintf(stderr, "%s: Skewed caches support neither cores, prefetching nor set sampling\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    // The trace index in the top address bits would feed hashed set indexes
+    if(corun.count > 1 && (index_config.fn != INDEX_MODULO || index_config.skewed)) {
+        fprintf(stderr, "%s: Co-running traces need plain modulo set indexing\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if((checkpoint_file || restore_file) && (index_config.skewed || cores > 1 || corun.count > 1)) {
+        fprintf(stderr, "%s: Checkpoints cover one set-associative cache fed by one trace\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    // Snapshots hold only the main cache, these models would restart cold
+    if(restore_file && (classify || vbuffer_entries || prefetch_config.kind != PF_NONE || latency_enabled ||
+                        spatial_report)) {
+        fprintf(stderr, "%s: --load-checkpoint supports neither --3c, victim/miss caches, --prefetch, "
+                "--latency nor --spatial\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    // Heatmaps, telemetry and samples count only the slice, so must the summary
+    if(restore_file && (heatmap_file || heatmap.region_count || interval_period ||
+                        sample_config.mode != SAMPLE_NONE)) {
+        reset_counters = true;
+    }
+    if(restore_file) {
+        uint64_t offset;
+        if(!loadCheckpoint(&cache, restore_file, &offset)) {
+            return EXIT_FAILURE;
+        }
+        if(!start_given) {
+            start_at = offset;
+        }
+        if(reset_counters) {
+            cache.hit_count = cache.miss_count = cache.eviction_count = 0;
+        }
+    }
+    if(checkpoint_file && checkpoint_at_given && checkpoint_at < start_at) {
+        fprintf(stderr, "%s: --checkpoint-at %lu falls before the slice starting at %lu\n", argv[0],
+                checkpoint_at, start_at);
+        return EXIT_FAILURE;
+    }
+    if(cores > 1) {
+        if(corun.count > 1 || classify || spatial_report || vbuffer_entries || latency_enabled ||
+           prefetch_config.kind != PF_NONE || heatmap_file || heatmap.region_count || interval_period ||
+           sample_config.mode != SAMPLE_NONE) {
+            fprintf(stderr, "%s: Multi-core traces support neither co-running, --3c, --spatial, victim/miss caches, "
+                    "--latency, --prefetch, --heatmap, regions, --interval nor sampling\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(!initCoherence(&coherence, protocol, cores, set_len, line_size, block_len)) {
+            return EXIT_FAILURE;
+        }
+        for(unsigned i = 0; i < cores; i++) {
+            if(!setIndexFunction(coherence.caches + i, &index_config)) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    if(vbuffer_entries && !initVictimBuffer(&vbuffer, vbuffer_kind, vbuffer_entries)) {
+        return EXIT_FAILURE;
+    }
+    if(fetch_config.l2 && !fetch_enabled) {
+        fprintf(stderr, "%s: --l2 needs --icache or --unified\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    // Fetch counts are kept for one cache fed by one trace, all of it
+    if(fetch_enabled && (cores > 1 || corun.count > 1 || checkpoint_file || restore_file ||
+                         sample_config.mode != SAMPLE_NONE)) {
+        fprintf(stderr, "%s: Instruction fetches support neither cores, co-running, checkpoints nor sampling\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(fetch_enabled && !initFetchModel(&fetch, &fetch_config)) {
+        return EXIT_FAILURE;
+    }
+    // Regions and checkpoints hold virtual and physical addresses respectively
+    if((paging || compare_frames) && (heatmap.region_count || checkpoint_file || restore_file)) {
+        fprintf(stderr, "%s: Frame mapping supports neither regions nor checkpoints\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(paging && !initPageMap(&page_map, &page_config, &cache)) {
+        return EXIT_FAILURE;
+    }
+    if(compare_frames && !initPageCompare(&page_compare, &page_config, &cache)) {
+        return EXIT_FAILURE;
+    }
+    if(!victim_latency_given) {
+        latency_config.victim = latency_config.hit + 2;
+    }
+    if(latency_enabled && !initLatency(&latency, &latency_config, &cache)) {
+        return EXIT_FAILURE;
+    }
+    if(spatial_report && !initSpatial(&spatial, &cache)) {
+        perror("Error: ");
+        return EXIT_FAILURE;
+    }
+    if(prefetch_config.kind != PF_NONE && !initPrefetcher(&prefetcher, &prefetch_config, &cache)) {
+        return EXIT_FAILURE;
+    }
+    // Shadow capacity saturates, a cache that large never fills anyway
+    uint64_t lines = (set_len < 64 && line_size <= (~0UL >> set_len)) ? line_size << set_len : ~0UL;
+    if(classify && !initClassifier(&classifier, lines)) {
+        perror("Error: ");
+        return EXIT_FAILURE;
+    }
+    if((heatmap_file || heatmap.region_count) && !initHeatmap(&heatmap, cache.set_mask + 1)) {
+        perror("Error: ");
+        return EXIT_FAILURE;
+    }
+    FILE *telemetry_fptr = stdout;
+    if((telemetry_file || phase_threshold > 0) && !interval_period) {
+        fprintf(stderr, "%s: Interval telemetry needs --interval\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(telemetry_file && !(telemetry_fptr = fopen(telemetry_file, "w"))) {
+        perror("Error: ");
+        return EXIT_FAILURE;
+    }
+    if(sample_config.mode != SAMPLE_NONE && !initSampler(&sampler, &sample_config, &cache)) {
+        return EXIT_FAILURE;
+    }
+    if(interval_period && !initTelemetry(&telemetry, interval_period, phase_threshold, telemetry_fptr)) {
+        perror("Error: ");
+        return EXIT_FAILURE;
+    }
+    trace_reader_t reader;
+    if(corun.count == 1 && !openTraceThreads(&reader, corun.traces[0].file, parse_threads)) {
         perror("Error: ");
         return EXIT_FAILURE;
     }
+    if(corun.count == 1 && marker_file) {
+        setTraceMarkers(&reader, marker_file);
+    }
+    if(corun.count == 1 && fetch_enabled) {
+        setTraceFetches(&reader, true);
+    }
+    if(corun.count > 1 && marker_file) {
+        fprintf(stderr, "%s: Markers only apply to a single trace\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(corun.count > 1 && !startCorun(&corun, &cache)) {
+        return EXIT_FAILURE;
+    }
 
-    uint8_t set_size = 1 << set_len;
-    set_t *cache = calloc(set_size, sizeof(set_t));
-    // Initialize set array
-    for(uint8_t i = 0; i < set_size; i++) {
-        cache[i].size = 0;
-        INIT_LIST_HEAD(&(cache[i].line_head));
+    if(memoize && !startMemo(&memo)) {
+        memoize = false;
     }
 
-    char buf[BUFFER_SIZE] = { 0 };
-    char cmd;
-    uint64_t addr, offset, set, tag;
-    uint64_t set_mask = ((~0UL) >> ((sizeof(uint64_t) << 3) - set_len)) << (block_len);
-    result_t ret;
-    while((fgets(buf, sizeof(buf), fptr) != NULL)) {
-        // Avoid 'only new line ending' on the last line
-        // Also avoid instruction load command
-        if(buf[0] != '\r' && buf[0] != '\n' && buf[0] == ' ') {
-            sscanf(buf, " %c %lxu,%lxu", &cmd, &addr, &offset);
-            if(verbose) {
-                // Remove new line char at the end of line
-                if(buf[strlen(buf)-1] == '\n') {
-                    buf[strlen(buf)-1] = 0;
-                    if(buf[strlen(buf)-1] == '\r') {
-                        buf[strlen(buf)-1] = 0;
-                    }
-                }
-                printf("%s", buf+1);
-            }
-            set = (addr & set_mask) >> (block_len);
-            tag = getTag(addr);
-            switch (cmd) {
-                case 'L': {
-                    ret = load(cache+set, tag);
-                    break;
-                }
-                case 'S': {
-                    ret = store(cache+set, tag);
-                    break;
-                }
-                case 'M': {
-                    ret = load(cache+set, tag);
-                    if(verbose) {
-                        if(ret.miss) {
-                            printf(" miss");
-                        }
-                        else if(ret.hit) {
-                            printf(" hit");
-                        }
-                        if(ret.eviction) {
-                            printf(" eviction");
-                        }
-                    }
-                    ret = store(cache+set, tag);
-                    break;
-                }
-                default:
-                    break;
-            }
-            if(verbose) {
-                if(ret.miss) {
-                    printf(" miss");
-                }
-                else if(ret.hit) {
-                    printf(" hit");
-                }
-                if(ret.eviction) {
-                    printf(" eviction");
-                }
-                puts("");
-            }
+    // Bulk runs only count the hits they skip, nothing else may watch them
+    bulk_runs = !verbose && prefetch_config.kind == PF_NONE && !classify && !heatmap.set_count &&
+                !interval_period && sample_config.mode == SAMPLE_NONE && corun.count == 1 &&
+                cores == 1 && !split && !index_config.skewed && !spatial_report && !vbuffer_entries &&
+                !latency_enabled && !checkpoint_file && !restore_file && !start_given && stop_at == ~0UL &&
+                !fetch_enabled && !paging && !compare_frames;
+    trace_record_t rec;
+    uint64_t records = 0;
+    if(corun.count == 1 && timing) {
+        records = simulateTimed(&reader, verbose);
+        closeTrace(&reader);
+    }
+    else if(corun.count == 1) {
+        while(nextRecord(&reader, &rec) && runRecord(&rec, reader.buf, verbose));
+        closeTrace(&reader);
+    }
+    else {
+        // Reading and simulating interleave too finely to time apart
+        const char *text;
+        int asid;
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while((asid = nextCorun(&corun, &rec, &text)) >= 0) {
+            current_asid = asid;
+            cache.alloc_mask = corun.traces[asid].way_mask;
+            simulateRecord(&rec, text, verbose);
+            records++;
+        }
+        simulate_seconds = secondsSince(&start);
+        if(corun.failed) {
+            return EXIT_FAILURE;
+        }
+    }
+    if(core_overflow) {
+        fprintf(stderr, "%s: Record %lu runs on core %u, but --cores is %u\n", argv[0], position, current_core, cores);
+        return EXIT_FAILURE;
+    }
+    if(checkpoint_file && checkpoint_at_given && checkpoint_at > position) {
+        fprintf(stderr, "%s: --checkpoint-at %lu is past the end at record %lu\n", argv[0], checkpoint_at,
+                position);
+        return EXIT_FAILURE;
+    }
+    if(checkpoint_file && !checkpoint_every && (!checkpoint_at_given || checkpoint_at == position) &&
+       !saveCheckpoint(&cache, position, checkpoint_file)) {
+        return EXIT_FAILURE;
+    }
+    if(interval_period) {
+        finishTelemetry(&telemetry);
+        if(telemetry_fptr != stdout) {
+            fclose(telemetry_fptr);
         }
     }
-    fclose(fptr);
 
-    printSummary(hit_count, miss_count, eviction_count);
-    for(uint8_t i = 0; i < set_size; i++) {
-        freeLineList(&(cache[i].line_head));
+    if(sample_config.mode != SAMPLE_NONE) {
+        // Report the extrapolated totals in place of the simulated ones
+        estimate_t misses, evictions;
+        estimateSample(&sampler, &misses, &evictions);
+        printSummary((int)(sampler.total - llround(misses.value)), (int)llround(misses.value),
+                     (int)llround(evictions.value));
+        printSampleStats(&sampler);
+        freeSampler(&sampler);
+    }
+    else if(cores > 1) {
+        counters_t total = coherenceTotals(&coherence);
+        printSummary((int)total.hits, (int)total.misses, (int)total.evictions);
+        printCoherenceStats(&coherence);
+        freeCoherence(&coherence);
+    }
+    else {
+        // In unified mode the main cache also counted the fetches
+        counters_t inst = fetch_config.unified ? fetch.inst : (counters_t){ 0 };
+        printSummary((int)(cache.hit_count - inst.hits), (int)(cache.miss_count - inst.misses),
+                     (int)(cache.eviction_count - inst.evictions));
+    }
+    if(prefetch_config.kind != PF_NONE) {
+        printPrefetchStats(&prefetcher);
+        freePrefetcher(&prefetcher);
+    }
+    if(classify) {
+        printClassifierStats(&classifier);
+        freeClassifier(&classifier);
+    }
+    if(heatmap.set_count) {
+        printRegionStats(&heatmap);
+        if(heatmap_file && !writeHeatmap(&heatmap, heatmap_file)) {
+            return EXIT_FAILURE;
+        }
+        freeHeatmap(&heatmap);
+    }
+    if(interval_period) {
+        printTelemetryStats(&telemetry);
+    }
+    if(corun.count > 1) {
+        printCorunStats(&corun);
+        finishCorun(&corun);
+    }
+    if(spatial_report) {
+        printSpatialStats(&spatial);
+        freeSpatial(&spatial);
+    }
+    if(vbuffer_entries) {
+        printVictimBufferStats(&vbuffer);
+        freeVictimBuffer(&vbuffer);
+    }
+    if(latency_enabled) {
+        printLatencyStats(&latency);
+        freeLatency(&latency);
+    }
+    if(fetch_enabled) {
+        printFetchStats(&fetch);
+        freeFetchModel(&fetch);
+    }
+    if(paging) {
+        printPageMapStats(&page_map);
+        freePageMap(&page_map);
+    }
+    if(compare_frames) {
+        printPageCompareStats(&page_compare);
+        freePageCompare(&page_compare);
+    }
+    freeCache(&cache);
+    if(timing) {
+        printTiming(records);
+    }
+    if(memoize) {
+        finishMemo(&memo);
     }
-    free(cache);
-    free(trace_file);
     return 0;
 }
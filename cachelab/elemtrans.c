@@ -0,0 +1,68 @@
+/*
+ * elemtrans.c - Transposes specialized by element type
+ *
+ * DEFINE_ELEM_TRANS expands into a row-wise and a tiled transpose of
+ * one element type. Tiles are square with one cache block of elements
+ * on a side, so a tile row of A and a tile column of B each fill whole
+ * blocks: 32x32 bytes, 16x16 halfwords, 8x8 ints, 4x4 doubles and 2x2
+ * 16-byte records for 32-byte blocks. Records wider than a block get
+ * 1x1 tiles, which is the row-wise scan again.
+ */
+#include "elemtrans.h"
+
+#define ELEM_TILE(type) \
+    (sizeof(type) < ELEM_BLOCK_BYTES ? (int)(ELEM_BLOCK_BYTES / sizeof(type)) : 1)
+
+#define DEFINE_ELEM_TRANS(name, type)                                          \
+char trans_##name##_desc[] = "Row-wise scan, " #type " elements";              \
+void trans_##name(int M, int N, void *A, void *B)                              \
+{                                                                              \
+    type (*a)[M] = A;                                                          \
+    type (*b)[N] = B;                                                          \
+    int i, j;                                                                  \
+                                                                               \
+    for (i = 0; i < N; i++) {                                                  \
+        for (j = 0; j < M; j++)                                                \
+            b[j][i] = a[i][j];                                                 \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+char trans_##name##_tiled_desc[] = "Tiled by cache block, " #type " elements"; \
+void trans_##name##_tiled(int M, int N, void *A, void *B)                      \
+{                                                                              \
+    type (*a)[M] = A;                                                          \
+    type (*b)[N] = B;                                                          \
+    int tile = ELEM_TILE(type);                                                \
+    int i, j, ii, jj;                                                          \
+                                                                               \
+    for (ii = 0; ii < N; ii += tile) {                                         \
+        for (jj = 0; jj < M; jj += tile) {                                     \
+            for (i = ii; i < ii + tile && i < N; i++) {                        \
+                for (j = jj; j < jj + tile && j < M; j++)                      \
+                    b[j][i] = a[i][j];                                         \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+}
+
+DEFINE_ELEM_TRANS(u8, uint8_t)
+DEFINE_ELEM_TRANS(u16, uint16_t)
+DEFINE_ELEM_TRANS(u32, uint32_t)
+DEFINE_ELEM_TRANS(f64, double)
+DEFINE_ELEM_TRANS(e128, elem128_t)
+
+#define REGISTER_ELEM_TRANS(name, type)                                          \
+    do {                                                                         \
+        registerElemTransFunction(trans_##name, trans_##name##_desc, sizeof(type)); \
+        registerElemTransFunction(trans_##name##_tiled, trans_##name##_tiled_desc, \
+                                  sizeof(type));                                 \
+    } while (0)
+
+void registerElemFunctions()
+{
+    REGISTER_ELEM_TRANS(u8, uint8_t);
+    REGISTER_ELEM_TRANS(u16, uint16_t);
+    REGISTER_ELEM_TRANS(u32, uint32_t);
+    REGISTER_ELEM_TRANS(f64, double);
+    REGISTER_ELEM_TRANS(e128, elem128_t);
+}
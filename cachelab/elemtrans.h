@@ -0,0 +1,21 @@
+/*
+ * elemtrans.h - Transposes of 1, 2, 4, 8 and 16 byte elements
+ */
+#ifndef CACHELAB_ELEMTRANS_H
+#define CACHELAB_ELEMTRANS_H
+
+#include <stdint.h>
+#include "cachelab.h"
+
+/* Block size of the cache the tiles are shaped for (b=5 in the lab) */
+#define ELEM_BLOCK_BYTES 32
+
+/* A 16-byte record, such as a pair of doubles */
+typedef struct elem128{
+    uint64_t lo, hi;
+} elem128_t;
+
+/* Register the row-wise and tiled transposes of every element type */
+void registerElemFunctions();
+
+#endif /* CACHELAB_ELEMTRANS_H */
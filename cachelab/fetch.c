@@ -0,0 +1,86 @@
+/*
+ * fetch.c - Instruction fetch simulation
+ *
+ * The I lines of a trace are fetched either from a split L1I of their
+ * own or, in unified mode, from the main cache alongside the data, where
+ * the two evict each other. Fetches bypass the data models (prefetcher,
+ * classifier, victim cache and so on) and are not counted in the summary
+ * line, which stays the data result test-csim expects. With an L2 the
+ * demand misses of both L1s are looked up in it, so instructions and data
+ * contend for its capacity. The L2 is filled on every L1 miss and knows
+ * nothing of L1 evictions (non-inclusive, no write-backs).
+ */
+#include "fetch.h"
+#include <stdio.h>
+#include <string.h>
+
+bool parseGeometry(const char *spec, geometry_t *geometry){
+    unsigned set_len, block_len;
+    unsigned long line_size;
+    char tail;
+    if(sscanf(spec, "%u,%lu,%u%c", &set_len, &line_size, &block_len, &tail) != 3 || !line_size) {
+        fprintf(stderr, "Error: Cache geometry '%s' is not s,E,b\n", spec);
+        return false;
+    }
+    geometry->set_len = set_len;
+    geometry->line_size = line_size;
+    geometry->block_len = block_len;
+    return true;
+}
+
+bool initFetchModel(fetch_model_t *fm, const fetch_config_t *config){
+    memset(fm, 0, sizeof(fetch_model_t));
+    fm->unified = config->unified;
+    fm->has_l2 = config->l2;
+    if(!fm->unified && !initCache(&(fm->icache), config->icache.set_len, config->icache.line_size,
+                                  config->icache.block_len)) {
+        return false;
+    }
+    if(fm->has_l2 && !initCache(&(fm->l2), config->l2_geometry.set_len, config->l2_geometry.line_size,
+                                config->l2_geometry.block_len)) {
+        return false;
+    }
+    return true;
+}
+
+void freeFetchModel(fetch_model_t *fm){
+    if(!fm->unified) {
+        freeCache(&(fm->icache));
+    }
+    if(fm->has_l2) {
+        freeCache(&(fm->l2));
+    }
+}
+
+result_t fetchInstruction(fetch_model_t *fm, cache_t *main, uint64_t addr){
+    result_t ret = accessCache(fm->unified ? main : &(fm->icache), addr);
+    countResult(&(fm->inst), &ret);
+    if(ret.miss && fm->has_l2) {
+        result_t l2 = accessCache(&(fm->l2), addr);
+        countResult(&(fm->l2_inst), &l2);
+    }
+    return ret;
+}
+
+void recordDataAccess(fetch_model_t *fm, uint64_t addr, const result_t *ret, bool absorbed){
+    countResult(&(fm->data), ret);
+    if(ret->miss && !absorbed && fm->has_l2) {
+        result_t l2 = accessCache(&(fm->l2), addr);
+        countResult(&(fm->l2_data), &l2);
+    }
+}
+
+static void printCounters(const char *name, const counters_t *count){
+    uint64_t accesses = count->hits + count->misses;
+    printf("%s: accesses:%lu hits:%lu misses:%lu evictions:%lu miss-rate:%.2f%%\n", name, accesses,
+           count->hits, count->misses, count->evictions, accesses ? 100.0 * count->misses / accesses : 0);
+}
+
+void printFetchStats(const fetch_model_t *fm){
+    printCounters(fm->unified ? "L1-unified-I" : "L1I", &(fm->inst));
+    printCounters(fm->unified ? "L1-unified-D" : "L1D", &(fm->data));
+    if(fm->has_l2) {
+        printCounters("L2-I", &(fm->l2_inst));
+        printCounters("L2-D", &(fm->l2_data));
+    }
+}
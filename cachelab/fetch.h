@@ -0,0 +1,47 @@
+/*
+ * fetch.h - Instruction fetch model: a split L1I or a unified L1, and an
+ *           optional shared L2 behind both
+ */
+#ifndef CSIM_FETCH_H
+#define CSIM_FETCH_H
+
+#include "cache.h"
+
+// Geometry of one cache level, as given to -s, -E and -b
+typedef struct geometry{
+    unsigned set_len;
+    uint64_t line_size;
+    unsigned block_len;
+}geometry_t;
+
+typedef struct fetch_config{
+    // Fetches share the main cache instead of going to their own L1I
+    bool unified;
+    geometry_t icache;
+    // Shared level looked up on L1 misses of both kinds
+    bool l2;
+    geometry_t l2_geometry;
+}fetch_config_t;
+
+typedef struct fetch_model{
+    bool unified, has_l2;
+    cache_t icache;
+    cache_t l2;
+    // L1 and L2 results of instruction fetches and data accesses
+    counters_t inst, data;
+    counters_t l2_inst, l2_data;
+}fetch_model_t;
+
+// Parse "s,E,b" into a cache geometry
+bool parseGeometry(const char *spec, geometry_t *geometry);
+bool initFetchModel(fetch_model_t *fm, const fetch_config_t *config);
+void freeFetchModel(fetch_model_t *fm);
+
+// Fetch the instruction at addr, through main in unified mode
+result_t fetchInstruction(fetch_model_t *fm, cache_t *main, uint64_t addr);
+// Count a data access whose main cache result was ret. Misses the
+// victim/miss cache absorbed do not reach the L2.
+void recordDataAccess(fetch_model_t *fm, uint64_t addr, const result_t *ret, bool absorbed);
+void printFetchStats(const fetch_model_t *fm);
+
+#endif /* CSIM_FETCH_H */
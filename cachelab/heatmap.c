@@ -0,0 +1,215 @@
+/*
+ * heatmap.c - Miss attribution by cache set and by address region
+ *
+ * Regions are typically the bounds of the arrays of a kernel, so a miss
+ * and the eviction it causes can be charged to the data structure that
+ * touched the set. Region lookup is a linear scan of at most MAX_REGIONS
+ * ranges, cheap enough to keep the counters on for whole traces.
+ */
+#include "heatmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool initHeatmap(heatmap_t *map, uint64_t set_count){
+    // Regions may already have been added while parsing options
+    map->set_count = set_count;
+    if(set_count > DENSE_SET_LIMIT) {
+        return initAddrMap(&(map->sparse), 1024);
+    }
+    return (map->sets = calloc(set_count, sizeof(counters_t))) != NULL;
+}
+
+void freeHeatmap(heatmap_t *map){
+    free(map->sets);
+    free(map->set_ids);
+    map->sets = NULL;
+    map->set_ids = NULL;
+    if(map->sparse.keys) {
+        freeAddrMap(&(map->sparse));
+    }
+}
+
+static counters_t* findSetCounters(heatmap_t *map, uint64_t index){
+    if(!map->sparse.keys) {
+        return map->sets + index;
+    }
+    bool inserted;
+    uint64_t *slot = addrMapInsert(&(map->sparse), index, map->set_used, &inserted);
+    if(!slot) {
+        perror("Error: ");
+        exit(EXIT_FAILURE);
+    }
+    if(inserted) {
+        if(map->set_used == map->set_alloc) {
+            size_t alloc = map->set_alloc ? map->set_alloc * 2 : 1024;
+            counters_t *sets = realloc(map->sets, alloc * sizeof(counters_t));
+            uint64_t *ids = realloc(map->set_ids, alloc * sizeof(uint64_t));
+            if(!sets || !ids) {
+                perror("Error: ");
+                exit(EXIT_FAILURE);
+            }
+            map->sets = sets;
+            map->set_ids = ids;
+            map->set_alloc = alloc;
+        }
+        memset(map->sets + map->set_used, 0, sizeof(counters_t));
+        map->set_ids[map->set_used++] = index;
+    }
+    return map->sets + *slot;
+}
+
+// Number of counter slots and the set each one belongs to
+static inline uint64_t setSlots(const heatmap_t *map){
+    return map->sparse.keys ? map->set_used : map->set_count;
+}
+
+static inline uint64_t slotSet(const heatmap_t *map, uint64_t slot){
+    return map->sparse.keys ? map->set_ids[slot] : slot;
+}
+
+static bool pushRegion(heatmap_t *map, const char *name, uint64_t start, uint64_t end){
+    if(map->region_count == MAX_REGIONS) {
+        fprintf(stderr, "Error: At most %d regions can be tracked\n", MAX_REGIONS);
+        return false;
+    }
+    if(end <= start) {
+        fprintf(stderr, "Error: Region %s is empty\n", name);
+        return false;
+    }
+    // Names go unquoted into the CSV and as strings into the JSON
+    for(const char *c = name; *c; c++) {
+        if(*c == ',' || *c == '"' || *c == '\\' || (unsigned char)*c < ' ') {
+            fprintf(stderr, "Error: Region name %s may not contain commas, quotes, backslashes or control characters\n", name);
+            return false;
+        }
+    }
+    region_t *region = map->regions + map->region_count++;
+    memset(region, 0, sizeof(region_t));
+    strncpy(region->name, name, REGION_NAME_LEN - 1);
+    region->start = start;
+    region->end = end;
+    return true;
+}
+
+bool addRegion(heatmap_t *map, const char *spec){
+    char name[REGION_NAME_LEN];
+    uint64_t start, end;
+    if(sscanf(spec, "%31[^:]:%lx:%lx", name, &start, &end) != 3) {
+        fprintf(stderr, "Error: Bad region '%s', expected name:start:end\n", spec);
+        return false;
+    }
+    return pushRegion(map, name, start, end);
+}
+
+bool loadRegions(heatmap_t *map, const char *file){
+    FILE *fptr;
+    char name[REGION_NAME_LEN];
+    uint64_t start, end;
+    if(!(fptr = fopen(file, "r"))) {
+        perror("Error: ");
+        return false;
+    }
+    while(fscanf(fptr, "%31s %lx %lx", name, &start, &end) == 3) {
+        if(!pushRegion(map, name, start, end)) {
+            fclose(fptr);
+            return false;
+        }
+    }
+    fclose(fptr);
+    return true;
+}
+
+static inline region_t* findRegion(heatmap_t *map, uint64_t addr){
+    for(unsigned i = 0; i < map->region_count; i++) {
+        if(addr >= map->regions[i].start && addr < map->regions[i].end) {
+            return map->regions + i;
+        }
+    }
+    return NULL;
+}
+
+void recordHeatmap(heatmap_t *map, const cache_t *cache, uint64_t addr, const result_t *ret){
+    counters_t *set = findSetCounters(map, getSetIndex(cache, getTag(cache, addr)));
+    region_t *region = map->region_count ? findRegion(map, addr) : NULL;
+    set->hits += ret->hit;
+    set->misses += ret->miss;
+    set->evictions += ret->eviction;
+    if(region) {
+        region->count.hits += ret->hit;
+        region->count.misses += ret->miss;
+        region->count.evictions += ret->eviction;
+    }
+    if(ret->eviction && map->region_count) {
+        region_t *victim = findRegion(map, ret->victim.tag << cache->block_len);
+        if(victim) {
+            victim->evicted++;
+        }
+    }
+}
+
+void printRegionStats(const heatmap_t *map){
+    for(unsigned i = 0; i < map->region_count; i++) {
+        const region_t *region = map->regions + i;
+        printf("region %s: hits:%lu misses:%lu evictions:%lu evicted:%lu\n", region->name,
+               region->count.hits, region->count.misses, region->count.evictions,
+               region->evicted);
+    }
+}
+
+static void writeCSV(const heatmap_t *map, FILE *fptr){
+    fputs("kind,name,hits,misses,evictions,evicted\n", fptr);
+    for(uint64_t i = 0; i < setSlots(map); i++) {
+        const counters_t *set = map->sets + i;
+        if(set->hits || set->misses) {
+            fprintf(fptr, "set,%lu,%lu,%lu,%lu,\n", slotSet(map, i), set->hits,
+                    set->misses, set->evictions);
+        }
+    }
+    for(unsigned i = 0; i < map->region_count; i++) {
+        const region_t *region = map->regions + i;
+        fprintf(fptr, "region,%s,%lu,%lu,%lu,%lu\n", region->name, region->count.hits,
+                region->count.misses, region->count.evictions, region->evicted);
+    }
+}
+
+static void writeJSON(const heatmap_t *map, FILE *fptr){
+    // Sets are [set, hits, misses, evictions], untouched sets left out
+    bool first = true;
+    fputs("{\"sets\":[", fptr);
+    for(uint64_t i = 0; i < setSlots(map); i++) {
+        const counters_t *set = map->sets + i;
+        if(set->hits || set->misses) {
+            fprintf(fptr, "%s[%lu,%lu,%lu,%lu]", first ? "" : ",", slotSet(map, i),
+                    set->hits, set->misses, set->evictions);
+            first = false;
+        }
+    }
+    fputs("],\"regions\":[", fptr);
+    for(unsigned i = 0; i < map->region_count; i++) {
+        const region_t *region = map->regions + i;
+        fprintf(fptr, "%s{\"name\":\"%s\",\"start\":\"0x%lx\",\"end\":\"0x%lx\","
+                "\"hits\":%lu,\"misses\":%lu,\"evictions\":%lu,\"evicted\":%lu}",
+                i ? "," : "", region->name, region->start, region->end,
+                region->count.hits, region->count.misses, region->count.evictions,
+                region->evicted);
+    }
+    fputs("]}\n", fptr);
+}
+
+bool writeHeatmap(const heatmap_t *map, const char *file){
+    FILE *fptr;
+    size_t len = strlen(file);
+    if(!(fptr = fopen(file, "w"))) {
+        perror("Error: ");
+        return false;
+    }
+    if(len >= 5 && strcmp(file + len - 5, ".json") == 0) {
+        writeJSON(map, fptr);
+    }
+    else {
+        writeCSV(map, fptr);
+    }
+    fclose(fptr);
+    return true;
+}
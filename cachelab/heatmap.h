@@ -0,0 +1,45 @@
+/*
+ * heatmap.h - Per-set and per-address-region hit/miss/eviction counters
+ */
+#ifndef CSIM_HEATMAP_H
+#define CSIM_HEATMAP_H
+
+#include "cache.h"
+
+#define MAX_REGIONS 16
+#define REGION_NAME_LEN 32
+
+typedef struct region{
+    char name[REGION_NAME_LEN];
+    uint64_t start, end; // [start, end)
+    counters_t count;
+    // Lines of this region evicted, whoever caused it
+    uint64_t evicted;
+}region_t;
+
+typedef struct heatmap{
+    // Indexed by set for dense caches. For sparse caches the sparse map
+    // gives the slot of a set and set_ids the set of a slot.
+    counters_t *sets;
+    uint64_t set_count;
+    addrmap_t sparse;
+    uint64_t *set_ids;
+    size_t set_used, set_alloc;
+    region_t regions[MAX_REGIONS];
+    unsigned region_count;
+}heatmap_t;
+
+bool initHeatmap(heatmap_t *map, uint64_t set_count);
+void freeHeatmap(heatmap_t *map);
+
+// Parse "name:start:end" with hex addresses
+bool addRegion(heatmap_t *map, const char *spec);
+// Read one "name start end" region per line
+bool loadRegions(heatmap_t *map, const char *file);
+
+void recordHeatmap(heatmap_t *map, const cache_t *cache, uint64_t addr, const result_t *ret);
+void printRegionStats(const heatmap_t *map);
+// Write CSV, or JSON if file ends in .json
+bool writeHeatmap(const heatmap_t *map, const char *file);
+
+#endif /* CSIM_HEATMAP_H */
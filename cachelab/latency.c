@@ -0,0 +1,111 @@
+/*
+ * latency.c - Cycle estimate of the simulated accesses
+ *
+ * Accesses issue in order, one per cycle, and do not wait for each other
+ * unless a resource runs out. A hit completes after the hit latency, or
+ * when the fill it hits under arrives. A miss needs a free MSHR, stalling
+ * issue until one frees, then queues for the DRAM channel, which moves
+ * one line per transfer time. Its data arrives the memory latency after
+ * the channel takes it. Writebacks and prefetch traffic are not modelled.
+ */
+#include "latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+bool parseLatency(const char *spec, latency_config_t *config){
+    unsigned hit, memory;
+    char tail;
+    if(sscanf(spec, "%u,%u%c", &hit, &memory, &tail) != 2) {
+        fprintf(stderr, "Error: Latency '%s' is not hit,memory cycles\n", spec);
+        return false;
+    }
+    config->hit = hit;
+    config->memory = memory;
+    return true;
+}
+
+bool initLatency(latency_model_t *lm, const latency_config_t *config, const cache_t *cache){
+    memset(lm, 0, sizeof(latency_model_t));
+    lm->config = *config;
+    if(!config->mshrs || config->bytes_per_cycle <= 0) {
+        fprintf(stderr, "Error: Latency model needs MSHRs and a positive bandwidth\n");
+        return false;
+    }
+    lm->line_bytes = 1UL << cache->block_len;
+    lm->transfer = (uint64_t)ceil(lm->line_bytes / config->bytes_per_cycle);
+    if(!(lm->mshrs = calloc(config->mshrs, sizeof(mshr_t)))) {
+        perror("Error: ");
+        return false;
+    }
+    return true;
+}
+
+void freeLatency(latency_model_t *lm){
+    free(lm->mshrs);
+    lm->mshrs = NULL;
+}
+
+void recordLatency(latency_model_t *lm, uint64_t block, const result_t *ret, bool absorbed){
+    const latency_config_t *config = &(lm->config);
+    uint64_t issue = lm->issue, start = issue, complete;
+    if(!ret->miss) {
+        complete = start + config->hit;
+        for(unsigned i = 0; i < config->mshrs; i++) {
+            if(lm->mshrs[i].block == block && lm->mshrs[i].done > complete) {
+                // Hit under miss, wait for the fill
+                complete = lm->mshrs[i].done;
+                lm->delayed_hits++;
+                break;
+            }
+        }
+    }
+    else if(absorbed) {
+        complete = start + config->victim;
+    }
+    else {
+        mshr_t *free_mshr = lm->mshrs;
+        for(unsigned i = 1; i < config->mshrs; i++) {
+            if(lm->mshrs[i].done < free_mshr->done) {
+                free_mshr = lm->mshrs + i;
+            }
+        }
+        if(free_mshr->done > start) {
+            lm->stall_cycles += free_mshr->done - start;
+            start = free_mshr->done;
+        }
+        uint64_t request = start + config->hit;
+        uint64_t channel = request > lm->channel_free ? request : lm->channel_free;
+        lm->channel_free = channel + lm->transfer;
+        complete = channel + config->memory;
+        free_mshr->block = block;
+        free_mshr->done = complete;
+        lm->fills++;
+    }
+    lm->issue = start + 1;
+    lm->accesses++;
+    lm->total_latency += complete - issue;
+    if(complete > lm->finish) {
+        lm->finish = complete;
+    }
+}
+
+uint64_t latencyCycles(const latency_model_t *lm){
+    return lm->finish > lm->issue ? lm->finish : lm->issue;
+}
+
+void printLatencyStats(const latency_model_t *lm){
+    uint64_t cycles = latencyCycles(lm);
+    double amat = lm->accesses ? (double)lm->total_latency / lm->accesses : 0;
+    double bandwidth = cycles ? (double)(lm->fills * lm->line_bytes) / cycles : 0;
+    printf("latency: cycles:%lu amat:%.2f stall-cycles:%lu delayed-hits:%lu\n",
+           cycles, amat, lm->stall_cycles, lm->delayed_hits);
+    printf("bandwidth: fills:%lu bytes/cycle:%.3f (%.2f GB/s at %.1f GHz)\n",
+           lm->fills, bandwidth, bandwidth * lm->config.clock_ghz, lm->config.clock_ghz);
+    FILE *fptr = fopen(LATENCY_RESULTS, "w");
+    if(fptr) {
+        fprintf(fptr, "%lu %.4f\n", cycles, amat);
+        fclose(fptr);
+    }
+}
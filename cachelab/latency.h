@@ -0,0 +1,51 @@
+/*
+ * latency.h - Cycle estimate of the simulated accesses: hit latencies,
+ *             limited outstanding misses and one shared DRAM channel
+ */
+#ifndef CSIM_LATENCY_H
+#define CSIM_LATENCY_H
+
+#include "cache.h"
+
+// File the cycle estimate is written to, next to .csim_results
+#define LATENCY_RESULTS ".csim_latency"
+
+typedef struct latency_config{
+    unsigned hit;           // Cycles of a main cache hit
+    unsigned victim;        // Cycles of a victim/miss cache hit
+    unsigned memory;        // Cycles from a DRAM request to its data
+    unsigned mshrs;         // Misses that may be outstanding at once
+    double bytes_per_cycle; // DRAM channel bandwidth
+    double clock_ghz;       // Only used to report bandwidth in GB/s
+}latency_config_t;
+
+// An outstanding miss: the block and the cycle its data arrives
+typedef struct mshr{
+    uint64_t block;
+    uint64_t done;
+}mshr_t;
+
+typedef struct latency_model{
+    latency_config_t config;
+    uint64_t line_bytes;
+    // Cycles one line occupies the DRAM channel
+    uint64_t transfer;
+    mshr_t *mshrs;
+    // Cycle the next access issues, the channel frees and the last
+    // access completes
+    uint64_t issue, channel_free, finish;
+    uint64_t accesses, total_latency, stall_cycles, delayed_hits, fills;
+}latency_model_t;
+
+// Parse "hit,memory" cycle counts
+bool parseLatency(const char *spec, latency_config_t *config);
+bool initLatency(latency_model_t *lm, const latency_config_t *config, const cache_t *cache);
+void freeLatency(latency_model_t *lm);
+
+// Time one access, absorbed tells a main cache miss the victim/miss cache held
+void recordLatency(latency_model_t *lm, uint64_t block, const result_t *ret, bool absorbed);
+uint64_t latencyCycles(const latency_model_t *lm);
+// Print the estimate and write "cycles amat" to LATENCY_RESULTS
+void printLatencyStats(const latency_model_t *lm);
+
+#endif /* CSIM_LATENCY_H */
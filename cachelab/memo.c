@@ -0,0 +1,253 @@
+/*
+ * memo.c - On-disk store of finished simulations
+ *
+ * An entry is a file named after the key hash holding the full key on
+ * its first line and the run's stdout after it. A run that misses the
+ * store redirects stdout into a temporary file in the store directory,
+ * copies it to the real stdout when done and renames it into place.
+ * rename() is atomic, so readers see a whole entry or none, and writers
+ * racing on the same key all publish the same content. The key stored in
+ * the entry is compared on replay to rule out hash collisions.
+ */
+#include "memo.h"
+#include "cachelab.h"
+#include "latency.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HASH_PRIME 0x9E3779B97F4A7C15UL
+
+static uint64_t mix(uint64_t h){
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDUL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t hashBytes(const unsigned char *data, size_t len, uint64_t seed){
+    uint64_t h = seed ^ (len * HASH_PRIME);
+    size_t i = 0;
+    // Eight bytes a step, the tail byte by byte
+    for(; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ mix(word)) * HASH_PRIME;
+    }
+    for(; i < len; i++) {
+        h = (h ^ data[i]) * HASH_PRIME;
+    }
+    return mix(h);
+}
+
+bool hashFile(const char *file, uint64_t *hash){
+    int fd = open(file, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    if(!st.st_size) {
+        *hash = hashBytes(NULL, 0, 0);
+        close(fd);
+        return true;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+    *hash = hashBytes(data, st.st_size, 0);
+    munmap(data, st.st_size);
+    return true;
+}
+
+static bool appendKey(memo_t *memo, const char *text){
+    size_t len = strlen(memo->key);
+    if(len + strlen(text) + 2 > MEMO_KEY_LEN) {
+        return false;
+    }
+    memo->key[len] = ' ';
+    strcpy(memo->key + len + 1, text);
+    return true;
+}
+
+// One parsed option of the key, with its place on the command line
+typedef struct memo_option{
+    char text[1024];
+    size_t name_len;
+    int order;
+}memo_option_t;
+
+// By name, then command line order: options that may repeat, such as -t
+// or --region, keep their relative order, which the results depend on
+static int compareOptions(const void *a, const void *b){
+    const memo_option_t *x = a, *y = b;
+    size_t len = x->name_len < y->name_len ? x->name_len : y->name_len;
+    int cmp = strncmp(x->text, y->text, len);
+    if(cmp || x->name_len != y->name_len) {
+        return cmp ? cmp : (x->name_len < y->name_len ? -1 : 1);
+    }
+    return x->order - y->order;
+}
+
+static bool isFileOption(const char *name, const char **file_options){
+    for(; *file_options; file_options++) {
+        if(!strcmp(name, *file_options)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool initMemo(memo_t *memo, const char *dir, int argc, char **argv, const char *optstring,
+              const struct option *options, const char **file_options){
+    memo_option_t *parsed = calloc(argc, sizeof(memo_option_t));
+    int count = 0, ch, index;
+    bool ok = parsed != NULL;
+    memset(memo, 0, sizeof(memo_t));
+    memo->dir = dir;
+    memo->saved_stdout = -1;
+    snprintf(memo->key, MEMO_KEY_LEN, "csim-%s", CSIM_VERSION);
+    // The caller's parse already succeeded, so no errors are printed here
+    opterr = 0;
+    optind = 0;
+    while(ok && (ch = getopt_long(argc, argv, optstring, options, &index)) != -1) {
+        char name[64];
+        uint64_t hash;
+        memo_option_t *opt = parsed + count;
+        if(ch == '?' || ch == ':') {
+            ok = false;
+            break;
+        }
+        if(ch < 256) {
+            snprintf(name, sizeof(name), "%c", ch);
+        }
+        else {
+            // Look the long option up, getopt_long only sets index when it
+            // matched by name
+            for(index = 0; options[index].name && options[index].val != ch; index++);
+            snprintf(name, sizeof(name), "%s", options[index].name);
+        }
+        // The store location does not change the results
+        if(!strcmp(name, "memo-dir")) {
+            continue;
+        }
+        opt->name_len = strlen(name);
+        opt->order = count;
+        if(!optarg) {
+            snprintf(opt->text, sizeof(opt->text), "%s", name);
+        }
+        else if(isFileOption(name, file_options)) {
+            ok = hashFile(optarg, &hash);
+            snprintf(opt->text, sizeof(opt->text), "%s=#%016lx", name, hash);
+        }
+        else {
+            snprintf(opt->text, sizeof(opt->text), "%s=%s", name, optarg);
+        }
+        count++;
+    }
+    optind = 1;
+    opterr = 1;
+    if(ok) {
+        qsort(parsed, count, sizeof(memo_option_t), compareOptions);
+    }
+    for(int i = 0; ok && i < count; i++) {
+        ok = appendKey(memo, parsed[i].text);
+    }
+    free(parsed);
+    if(!ok) {
+        return false;
+    }
+    memo->key_hash = hashBytes((const unsigned char*)memo->key, strlen(memo->key), 0);
+    snprintf(memo->path, sizeof(memo->path), "%s/%016lx", dir, memo->key_hash);
+    return true;
+}
+
+bool replayMemo(memo_t *memo){
+    FILE *fptr = fopen(memo->path, "r");
+    char line[MEMO_KEY_LEN + 2];
+    if(!fptr) {
+        return false;
+    }
+    if(!fgets(line, sizeof(line), fptr) || strncmp(line, memo->key, strlen(memo->key)) ||
+       line[strlen(memo->key)] != '\n') {
+        fclose(fptr);
+        return false;
+    }
+    while(fgets(line, sizeof(line), fptr)) {
+        int hits, misses, evictions;
+        unsigned long cycles;
+        double amat;
+        // Go through printSummary so .csim_results is rewritten too
+        if(sscanf(line, "hits:%d misses:%d evictions:%d", &hits, &misses, &evictions) == 3) {
+            printSummary(hits, misses, evictions);
+            continue;
+        }
+        if(sscanf(line, "latency: cycles:%lu amat:%lf", &cycles, &amat) == 2) {
+            FILE *latency_fptr = fopen(LATENCY_RESULTS, "w");
+            if(latency_fptr) {
+                fprintf(latency_fptr, "%lu %.4f\n", cycles, amat);
+                fclose(latency_fptr);
+            }
+        }
+        fputs(line, stdout);
+    }
+    fclose(fptr);
+    return true;
+}
+
+bool startMemo(memo_t *memo){
+    if(mkdir(memo->dir, 0777) < 0 && errno != EEXIST) {
+        return false;
+    }
+    snprintf(memo->temp_path, sizeof(memo->temp_path), "%s/.tmp-XXXXXX", memo->dir);
+    int fd = mkstemp(memo->temp_path);
+    if(fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644);
+    fflush(stdout);
+    if((memo->saved_stdout = dup(STDOUT_FILENO)) < 0 || dup2(fd, STDOUT_FILENO) < 0) {
+        close(fd);
+        unlink(memo->temp_path);
+        return false;
+    }
+    close(fd);
+    printf("%s\n", memo->key);
+    return true;
+}
+
+void finishMemo(memo_t *memo){
+    if(memo->saved_stdout < 0) {
+        return;
+    }
+    fflush(stdout);
+    fsync(STDOUT_FILENO);
+    dup2(memo->saved_stdout, STDOUT_FILENO);
+    close(memo->saved_stdout);
+    memo->saved_stdout = -1;
+
+    // Hand the captured output, without the key line, to the real stdout
+    FILE *fptr = fopen(memo->temp_path, "r");
+    char line[MEMO_KEY_LEN + 2];
+    if(fptr && fgets(line, sizeof(line), fptr)) {
+        size_t len;
+        while((len = fread(line, 1, sizeof(line), fptr)) > 0) {
+            fwrite(line, 1, len, stdout);
+        }
+    }
+    if(fptr) {
+        fclose(fptr);
+    }
+    fflush(stdout);
+    if(rename(memo->temp_path, memo->path) < 0) {
+        unlink(memo->temp_path);
+    }
+}
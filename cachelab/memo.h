@@ -0,0 +1,46 @@
+/*
+ * memo.h - On-disk store of finished simulations, keyed by the parsed
+ *          options, the content of the files they name and the simulator
+ *          version
+ */
+#ifndef CSIM_MEMO_H
+#define CSIM_MEMO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+
+#ifndef CSIM_VERSION
+#define CSIM_VERSION "dev"
+#endif
+
+// Environment variable naming the store when --memo-dir is not given
+#define MEMO_DIR_ENV "CSIM_MEMO_DIR"
+#define MEMO_KEY_LEN 4096
+
+typedef struct memo{
+    const char *dir;
+    // Options and trace hashes the entry must match, and their hash
+    char key[MEMO_KEY_LEN];
+    uint64_t key_hash;
+    char path[4096], temp_path[4096];
+    // Real stdout while the run is captured in the temporary entry
+    int saved_stdout;
+}memo_t;
+
+// 64-bit content hash of a file, false if it cannot be read
+bool hashFile(const char *file, uint64_t *hash);
+
+// Build the key of a run by parsing its arguments again with optstring and
+// options. Options named in file_options (long names, or the letter of a
+// short one) take input files, which are keyed by content.
+bool initMemo(memo_t *memo, const char *dir, int argc, char **argv, const char *optstring,
+              const struct option *options, const char **file_options);
+// Print a stored run and rewrite .csim_results, false if there is none
+bool replayMemo(memo_t *memo);
+// Capture stdout into a new entry, and publish it once the run is done
+bool startMemo(memo_t *memo);
+void finishMemo(memo_t *memo);
+
+#endif /* CSIM_MEMO_H */
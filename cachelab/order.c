@@ -0,0 +1,204 @@
+/*
+ * order.c - Conversions between row-major and the blocked and Morton
+ *     orders, and transposes working on them natively
+ *
+ * Morton indices are built by spreading the bits of a coordinate over
+ * the even bits of a word, with pdep where the compiler targets BMI2
+ * and shifts and masks otherwise. Lookup tables would work too, but
+ * their loads would show up in the traces the harness counts. Along a
+ * row the column part is advanced with (x - mask) & mask, which adds
+ * one to the spread bits in place.
+ */
+#include "order.h"
+#include <stdint.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#define EVEN_BITS 0x55555555u
+
+/* Scratch matrices of the round trip transposes, the largest is 256x256 */
+static int order_a[256 * 256];
+static int order_b[256 * 256];
+
+/* Move the low 16 bits of x to the even bits */
+static inline uint32_t spreadBits(uint32_t x)
+{
+#ifdef __BMI2__
+    return _pdep_u32(x, EVEN_BITS);
+#else
+    x &= 0xffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & EVEN_BITS;
+    return x;
+#endif
+}
+
+/* Gather the even bits of x into the low 16 bits */
+static inline uint32_t compactBits(uint32_t x)
+{
+#ifdef __BMI2__
+    return _pext_u32(x, EVEN_BITS);
+#else
+    x &= EVEN_BITS;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0f0f0f0f;
+    x = (x | (x >> 4)) & 0x00ff00ff;
+    x = (x | (x >> 8)) & 0x0000ffff;
+    return x;
+#endif
+}
+
+static inline int tileLength(int length, int t)
+{
+    return length - t * ORDER_TILE < ORDER_TILE ? length - t * ORDER_TILE : ORDER_TILE;
+}
+
+size_t orderSize(order_t order, int rows, int cols)
+{
+    size_t side = 1;
+    if (order != ORDER_MORTON)
+        return (size_t)rows * cols;
+    while (side < (size_t)rows || side < (size_t)cols)
+        side <<= 1;
+    return side * side;
+}
+
+/*
+ * convert - Copy between row-major rm and ordered om, into om when
+ *     to_order is set. Blocked matrices are copied a tile row at a time.
+ */
+static void convert(order_t order, int rows, int cols, int *rm, int *om, int to_order)
+{
+    int i, j;
+    if (order == ORDER_BLOCKED) {
+        for (int ti = 0; ti * ORDER_TILE < rows; ti++) {
+            int h = tileLength(rows, ti);
+            for (int tj = 0; tj * ORDER_TILE < cols; tj++) {
+                int w = tileLength(cols, tj);
+                int *tile = om + (size_t)ti * ORDER_TILE * cols + (size_t)tj * ORDER_TILE * h;
+                for (i = 0; i < h; i++) {
+                    int *row = rm + (size_t)(ti * ORDER_TILE + i) * cols + tj * ORDER_TILE;
+                    for (j = 0; j < w; j++) {
+                        if (to_order)
+                            tile[i * w + j] = row[j];
+                        else
+                            row[j] = tile[i * w + j];
+                    }
+                }
+            }
+        }
+        return;
+    }
+    for (i = 0; i < rows; i++) {
+        uint32_t high = spreadBits(i) << 1, low = 0;
+        for (j = 0; j < cols; j++) {
+            if (order == ORDER_MORTON) {
+                if (to_order)
+                    om[high | low] = rm[(size_t)i * cols + j];
+                else
+                    rm[(size_t)i * cols + j] = om[high | low];
+                low = (low - EVEN_BITS) & EVEN_BITS;
+            }
+            else if (to_order)
+                om[(size_t)i * cols + j] = rm[(size_t)i * cols + j];
+            else
+                rm[(size_t)i * cols + j] = om[(size_t)i * cols + j];
+        }
+    }
+}
+
+void toOrder(order_t order, int rows, int cols, const int *src, int *dst)
+{
+    convert(order, rows, cols, (int *)src, dst, 1);
+}
+
+void fromOrder(order_t order, int rows, int cols, const int *src, int *dst)
+{
+    convert(order, rows, cols, dst, (int *)src, 0);
+}
+
+/*
+ * trans_blocked - Transpose blocked A into blocked B. Tile (ti, tj) of A
+ *     becomes tile (tj, ti) of B; a full row of an A tile is read into
+ *     locals before it is written down a column of the B tile, so the
+ *     two tiles never evict each other mid-row.
+ */
+char trans_blocked_desc[] = "Blocked 8x8 order, native transpose";
+void trans_blocked(int M, int N, int A[N][M], int B[M][N])
+{
+    int *a = &A[0][0], *b = &B[0][0];
+    int t0, t1, t2, t3, t4, t5, t6, t7;
+
+    for (int ti = 0; ti * ORDER_TILE < N; ti++) {
+        int h = tileLength(N, ti);
+        for (int tj = 0; tj * ORDER_TILE < M; tj++) {
+            int w = tileLength(M, tj);
+            int *src = a + (size_t)ti * ORDER_TILE * M + (size_t)tj * ORDER_TILE * h;
+            int *dst = b + (size_t)tj * ORDER_TILE * N + (size_t)ti * ORDER_TILE * w;
+            for (int r = 0; r < h; r++) {
+                if (w == ORDER_TILE) {
+                    t0 = src[r * 8 + 0]; t1 = src[r * 8 + 1];
+                    t2 = src[r * 8 + 2]; t3 = src[r * 8 + 3];
+                    t4 = src[r * 8 + 4]; t5 = src[r * 8 + 5];
+                    t6 = src[r * 8 + 6]; t7 = src[r * 8 + 7];
+                    dst[0 * h + r] = t0; dst[1 * h + r] = t1;
+                    dst[2 * h + r] = t2; dst[3 * h + r] = t3;
+                    dst[4 * h + r] = t4; dst[5 * h + r] = t5;
+                    dst[6 * h + r] = t6; dst[7 * h + r] = t7;
+                }
+                else {
+                    for (int c = 0; c < w; c++)
+                        dst[c * h + r] = src[r * w + c];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * trans_morton - Transpose Morton A into Morton B. Swapping the row and
+ *     column of an element swaps the odd and even bits of its index, so
+ *     A is read in order and B written close behind.
+ */
+char trans_morton_desc[] = "Morton order, native transpose";
+void trans_morton(int M, int N, int A[N][M], int B[M][N])
+{
+    int *a = &A[0][0], *b = &B[0][0];
+    uint32_t size = orderSize(ORDER_MORTON, N, M);
+
+    for (uint32_t k = 0; k < size; k++) {
+        if (compactBits(k >> 1) < (uint32_t)N && compactBits(k) < (uint32_t)M)
+            b[((k & EVEN_BITS) << 1) | ((k >> 1) & EVEN_BITS)] = a[k];
+    }
+}
+
+/*
+ * The round trips take row-major A and B like any other function, and
+ * pay for converting to the order and back around the native transpose.
+ */
+char trans_blocked_round_desc[] = "Blocked 8x8 order, convert, transpose and convert back";
+void trans_blocked_round(int M, int N, int A[N][M], int B[M][N])
+{
+    toOrder(ORDER_BLOCKED, N, M, &A[0][0], order_a);
+    trans_blocked(M, N, (int (*)[M]) order_a, (int (*)[N]) order_b);
+    fromOrder(ORDER_BLOCKED, M, N, order_b, &B[0][0]);
+}
+
+char trans_morton_round_desc[] = "Morton order, convert, transpose and convert back";
+void trans_morton_round(int M, int N, int A[N][M], int B[M][N])
+{
+    toOrder(ORDER_MORTON, N, M, &A[0][0], order_a);
+    trans_morton(M, N, (int (*)[M]) order_a, (int (*)[N]) order_b);
+    fromOrder(ORDER_MORTON, M, N, order_b, &B[0][0]);
+}
+
+void registerOrderFunctions()
+{
+    registerOrderedTransFunction(trans_blocked, trans_blocked_desc, ORDER_BLOCKED);
+    registerOrderedTransFunction(trans_morton, trans_morton_desc, ORDER_MORTON);
+    registerTransFunction(trans_blocked_round, trans_blocked_round_desc);
+    registerTransFunction(trans_morton_round, trans_morton_round_desc);
+}
@@ -0,0 +1,30 @@
+/*
+ * order.h - Blocked and Morton (Z-order) element orders for the
+ *     matrices of the transpose functions
+ *
+ * A rows x cols matrix in ORDER_BLOCKED is cut into ORDER_TILE square
+ * tiles, stored tile row by tile row, each tile row-major; tiles on the
+ * right and bottom edges are narrower and take only the space they need.
+ * In ORDER_MORTON element (i, j) is at the index whose even bits are the
+ * bits of j and odd bits those of i, so the matrix takes the square of
+ * the power of two covering both dimensions.
+ */
+#ifndef CACHELAB_ORDER_H
+#define CACHELAB_ORDER_H
+
+#include <stddef.h>
+#include "cachelab.h"
+
+#define ORDER_TILE 8
+
+/* Number of ints a rows x cols matrix takes in order */
+size_t orderSize(order_t order, int rows, int cols);
+
+/* Convert a rows x cols matrix between row-major src and order dst */
+void toOrder(order_t order, int rows, int cols, const int *src, int *dst);
+void fromOrder(order_t order, int rows, int cols, const int *src, int *dst);
+
+/* Register the transposes working in blocked and Morton order */
+void registerOrderFunctions();
+
+#endif /* CACHELAB_ORDER_H */
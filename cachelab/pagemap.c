@@ -0,0 +1,159 @@
+/*
+ * pagemap.c - Page maps and frame allocation
+ *
+ * Caches beyond the L1 are physically indexed, so once the set index
+ * reaches above the page offset the frames the OS picks decide which
+ * pages collide. A page colour is the part of the set index above the
+ * page offset; with C colours, pages whose frames share a colour compete
+ * for the same 1/C of the sets. Identity keeps the virtual colours,
+ * sequential packs frames in first-touch order, random scatters them
+ * like a long-running system with fragmented memory, and the colouring
+ * policy gives every page a frame of its virtual page's colour, the way
+ * colouring allocators keep virtually contiguous data spread evenly.
+ *
+ * Pages are mapped on first touch; each trace of a co-run is its own
+ * address space. Its co-run tag above ASID_SHIFT is kept out of the page
+ * number and carried over to the physical address, so evictions are
+ * still charged to the right trace.
+ */
+#include "pagemap.h"
+#include "corun.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *policy_names[FRAME_POLICIES] = { "identity", "sequential", "random", "colour" };
+
+bool parseFramePolicy(const char *name, frame_policy_t *policy){
+    for(unsigned i = 0; i < FRAME_POLICIES; i++) {
+        if(!strcmp(name, policy_names[i])) {
+            *policy = (frame_policy_t)i;
+            return true;
+        }
+    }
+    if(!strcmp(name, "color")) {
+        *policy = FRAME_COLOUR;
+        return true;
+    }
+    return false;
+}
+
+const char* framePolicyName(frame_policy_t policy){
+    return policy_names[policy];
+}
+
+bool initPageMap(page_map_t *map, const page_config_t *config, const cache_t *cache){
+    memset(map, 0, sizeof(page_map_t));
+    map->policy = config->policy;
+    if(!config->page_size || (config->page_size & (config->page_size - 1)) ||
+       config->page_size < (1UL << cache->block_len)) {
+        fprintf(stderr, "Error: Page size must be a power of two no smaller than a block\n");
+        return false;
+    }
+    while((1UL << map->page_len) < config->page_size) {
+        map->page_len++;
+    }
+    unsigned way_len = cache->set_len + cache->block_len;
+    map->colours = (way_len > map->page_len) ? 1UL << (way_len - map->page_len) : 1;
+    map->phys_bits = (DEFAULT_PHYS_BITS > map->page_len) ? DEFAULT_PHYS_BITS : map->page_len + 1;
+    map->rng = config->seed;
+    return initAddrMap(&(map->frames), 1024) && initAddrMap(&(map->used), 1024) &&
+           initAddrMap(&(map->next_of_colour), 64);
+}
+
+void freePageMap(page_map_t *map){
+    freeAddrMap(&(map->frames));
+    freeAddrMap(&(map->used));
+    freeAddrMap(&(map->next_of_colour));
+}
+
+// splitmix64, so runs with the same seed map the same frames
+static uint64_t nextRandom(page_map_t *map){
+    uint64_t z = (map->rng += 0x9e3779b97f4a7c15UL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t allocateFrame(page_map_t *map, uint64_t vpn){
+    switch(map->policy) {
+        case FRAME_SEQUENTIAL:
+            return map->next_frame++;
+        case FRAME_RANDOM: {
+            // Keep at least half the frames free so a free one turns up fast
+            if(map->used.count * 2 >= 1UL << (map->phys_bits - map->page_len)) {
+                map->phys_bits++;
+            }
+            uint64_t mask = (1UL << (map->phys_bits - map->page_len)) - 1, frame;
+            bool inserted;
+            do {
+                frame = nextRandom(map) & mask;
+                addrMapInsert(&(map->used), frame, 0, &inserted);
+            } while(!inserted);
+            return frame;
+        }
+        case FRAME_COLOUR: {
+            uint64_t colour = vpn & (map->colours - 1);
+            bool inserted;
+            uint64_t *next = addrMapInsert(&(map->next_of_colour), colour, 0, &inserted);
+            return (*next)++ * map->colours + colour;
+        }
+        default:
+            return vpn;
+    }
+}
+
+uint64_t translate(page_map_t *map, unsigned asid, uint64_t addr){
+    uint64_t tag = addr >> ASID_SHIFT << ASID_SHIFT;
+    uint64_t vpn = (addr ^ tag) >> map->page_len;
+    uint64_t offset = addr & ((1UL << map->page_len) - 1);
+    // Page numbers stay below bit ASID_SHIFT - page_len, the asid goes above
+    uint64_t key = ((uint64_t)asid << (ASID_SHIFT - map->page_len)) | vpn;
+    uint64_t *frame = addrMapFind(&(map->frames), key);
+    if(!frame) {
+        bool inserted;
+        frame = addrMapInsert(&(map->frames), key, allocateFrame(map, vpn), &inserted);
+    }
+    return (*frame << map->page_len) | offset | tag;
+}
+
+void printPageMapStats(const page_map_t *map){
+    printf("page-map: policy:%s page-size:%lu colours:%lu pages:%lu\n", policy_names[map->policy],
+           1UL << map->page_len, map->colours, (uint64_t)map->frames.count);
+}
+
+bool initPageCompare(page_compare_t *pc, const page_config_t *config, const cache_t *cache){
+    memset(pc, 0, sizeof(page_compare_t));
+    for(unsigned i = 0; i < FRAME_POLICIES; i++) {
+        page_config_t policy_config = *config;
+        policy_config.policy = (frame_policy_t)i;
+        if(!initPageMap(pc->maps + i, &policy_config, cache) ||
+           !initCache(pc->caches + i, cache->set_len, cache->line_size, cache->block_len) ||
+           !setIndexFunction(pc->caches + i, &(cache->index))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void freePageCompare(page_compare_t *pc){
+    for(unsigned i = 0; i < FRAME_POLICIES; i++) {
+        freePageMap(pc->maps + i);
+        freeCache(pc->caches + i);
+    }
+}
+
+void recordPageCompare(page_compare_t *pc, unsigned asid, uint64_t addr){
+    for(unsigned i = 0; i < FRAME_POLICIES; i++) {
+        accessCache(pc->caches + i, translate(pc->maps + i, asid, addr));
+    }
+}
+
+void printPageCompareStats(const page_compare_t *pc){
+    uint64_t base = pc->caches[FRAME_IDENTITY].miss_count;
+    for(unsigned i = 0; i < FRAME_POLICIES; i++) {
+        const cache_t *cache = pc->caches + i;
+        printf("frames(%s): hits:%lu misses:%lu evictions:%lu change:%+.2f%%\n", policy_names[i],
+               cache->hit_count, cache->miss_count, cache->eviction_count,
+               base ? 100.0 * ((double)cache->miss_count - base) / base : 0);
+    }
+}
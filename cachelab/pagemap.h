@@ -0,0 +1,68 @@
+/*
+ * pagemap.h - Virtual to physical translation in front of the cache, with
+ *             identity, sequential, random and page-colouring frame
+ *             allocation
+ */
+#ifndef CSIM_PAGEMAP_H
+#define CSIM_PAGEMAP_H
+
+#include "cache.h"
+#include "addrmap.h"
+
+typedef enum frame_policy{
+    FRAME_IDENTITY = 0, // Physical address equals the virtual one
+    FRAME_SEQUENTIAL,   // Frames handed out in first-touch order
+    FRAME_RANDOM,       // Uniformly random free frame
+    FRAME_COLOUR        // Next free frame of the virtual page's colour
+}frame_policy_t;
+
+#define FRAME_POLICIES 4
+#define DEFAULT_PAGE_SIZE 4096
+// Physical address bits random frames are drawn from, grown when full
+#define DEFAULT_PHYS_BITS 32
+
+typedef struct page_config{
+    uint64_t page_size;
+    frame_policy_t policy;
+    uint64_t seed;
+}page_config_t;
+
+typedef struct page_map{
+    frame_policy_t policy;
+    unsigned page_len;
+    // Page colours of the cache: pages one way of it spans
+    uint64_t colours;
+    // Address space and virtual page number to frame, filled on first touch
+    addrmap_t frames;
+    // Frames taken, for the random policy
+    addrmap_t used;
+    unsigned phys_bits;
+    uint64_t rng;
+    // Next frame overall, and next frame of each colour
+    uint64_t next_frame;
+    addrmap_t next_of_colour;
+}page_map_t;
+
+// Every policy next to the main simulation, each with a plain LRU cache of
+// the main cache's geometry and index function
+typedef struct page_compare{
+    page_map_t maps[FRAME_POLICIES];
+    cache_t caches[FRAME_POLICIES];
+}page_compare_t;
+
+bool parseFramePolicy(const char *name, frame_policy_t *policy);
+const char* framePolicyName(frame_policy_t policy);
+
+// cache gives the geometry the page colours are counted for
+bool initPageMap(page_map_t *map, const page_config_t *config, const cache_t *cache);
+void freePageMap(page_map_t *map);
+// Physical address of addr in address space asid, mapping its page if new
+uint64_t translate(page_map_t *map, unsigned asid, uint64_t addr);
+void printPageMapStats(const page_map_t *map);
+
+bool initPageCompare(page_compare_t *pc, const page_config_t *config, const cache_t *cache);
+void freePageCompare(page_compare_t *pc);
+void recordPageCompare(page_compare_t *pc, unsigned asid, uint64_t addr);
+void printPageCompareStats(const page_compare_t *pc);
+
+#endif /* CSIM_PAGEMAP_H */
@@ -0,0 +1,250 @@
+/*
+ * prefetch.c - Next-line, stride and stream buffer prefetchers
+ *
+ * Prefetched lines are tagged when they are filled. A demand hit on a
+ * tagged line counts as useful (or late if the fill has not arrived yet),
+ * and evicting a tagged line before any demand counts as useless. Lines a
+ * prefetch fill pushes out are remembered, so a later demand miss on one
+ * of them is reported as pollution. Once they number as many as the
+ * cache has lines they are forgotten, since demand fills alone would
+ * have pushed the older ones out by then. Evictions by prefetch fills
+ * are counted apart from the cache's demand evictions.
+ */
+#include "prefetch.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STRIDE_REGION_BITS 12
+#define STRIDE_CONFIDENT 2
+
+static const char *kind_names[] = {"none", "next-line", "stride", "stream"};
+
+bool parsePrefetchKind(const char *name, prefetch_kind_t *kind){
+    for(size_t i = 0; i < sizeof(kind_names) / sizeof(kind_names[0]); i++) {
+        if(strcmp(name, kind_names[i]) == 0) {
+            *kind = (prefetch_kind_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool initPrefetcher(prefetcher_t *pf, const prefetch_config_t *config, const cache_t *cache){
+    memset(pf, 0, sizeof(prefetcher_t));
+    pf->config = *config;
+    pf->polluted_cap = (cache->set_mask + 1) * cache->line_size;
+    if(config->degree == 0 || config->degree > PF_MAX_DEGREE) {
+        fprintf(stderr, "Error: Prefetch degree must be 1 to %d\n", PF_MAX_DEGREE);
+        return false;
+    }
+    if(config->kind == PF_STREAM && (config->streams == 0 || config->streams > PF_MAX_STREAMS)) {
+        fprintf(stderr, "Error: Stream buffer count must be 1 to %d\n", PF_MAX_STREAMS);
+        return false;
+    }
+    for(size_t i = 0; i < PF_STRIDE_ENTRIES; i++) {
+        pf->stride_table[i].region = ADDRMAP_EMPTY;
+    }
+    return initAddrMap(&(pf->polluted), 64);
+}
+
+void freePrefetcher(prefetcher_t *pf){
+    freeAddrMap(&(pf->polluted));
+}
+
+// Fill block into the cache as a prefetched line unless it is already there
+static void issuePrefetch(prefetcher_t *pf, cache_t *cache, uint64_t block){
+    set_t *set = getSet(cache, block);
+    line_t victim;
+    if(findLine(cache, set, block) != NULL) {
+        return;
+    }
+    pf->issued++;
+    if(addLine(cache, set, block, true, &victim)) {
+        pf->evictions++;
+        if(victim.prefetched) {
+            pf->useless++;
+        }
+        else {
+            if(pf->polluted.count >= pf->polluted_cap) {
+                clearAddrMap(&(pf->polluted));
+            }
+            addrMapInsert(&(pf->polluted), victim.tag, 0, NULL);
+        }
+    }
+    // New line is always the most recently used one
+    list_entry(set->line_head.prev, line_t, list)->ready_time = cache->now + pf->config.latency;
+}
+
+static void issueRun(prefetcher_t *pf, cache_t *cache, uint64_t block, int64_t stride){
+    for(unsigned i = 0; i < pf->config.degree; i++) {
+        int64_t delta = stride * (int64_t)(pf->config.distance + i);
+        // Do not wrap around either end of the address space
+        if((delta < 0 && (uint64_t)(-delta) > block) || (delta > 0 && block + delta < block)) {
+            break;
+        }
+        issuePrefetch(pf, cache, block + delta);
+    }
+}
+
+static void trainStride(prefetcher_t *pf, cache_t *cache, uint64_t addr, uint64_t block){
+    uint64_t region = addr >> STRIDE_REGION_BITS;
+    stride_entry_t *entry = pf->stride_table + (region % PF_STRIDE_ENTRIES);
+    if(entry->region != region) {
+        entry->region = region;
+        entry->last_block = block;
+        entry->stride = 0;
+        entry->confidence = 0;
+        return;
+    }
+    int64_t stride = (int64_t)(block - entry->last_block);
+    // Accesses within the same block tell nothing about the stride
+    if(stride == 0) {
+        return;
+    }
+    if(stride == entry->stride) {
+        if(entry->confidence < STRIDE_CONFIDENT) {
+            entry->confidence++;
+        }
+    }
+    else {
+        entry->stride = stride;
+        entry->confidence = 0;
+    }
+    entry->last_block = block;
+    if(entry->confidence >= STRIDE_CONFIDENT) {
+        issueRun(pf, cache, block, stride);
+    }
+}
+
+static void refillStream(prefetcher_t *pf, cache_t *cache, stream_buffer_t *buf){
+    while(buf->count < pf->config.degree) {
+        unsigned tail = (buf->head + buf->count) % PF_MAX_DEGREE;
+        buf->block[tail] = buf->next_block++;
+        buf->ready_time[tail] = cache->now + pf->config.latency;
+        buf->count++;
+        pf->issued++;
+    }
+}
+
+/*
+ * supplyStream - Look block up in the stream buffers. Entries skipped over
+ *                are dropped as useless, the matching one moves to the cache.
+ */
+static bool supplyStream(prefetcher_t *pf, cache_t *cache, uint64_t block, bool *late){
+    for(unsigned i = 0; i < pf->config.streams; i++) {
+        stream_buffer_t *buf = pf->buffers + i;
+        for(unsigned k = 0; k < buf->count; k++) {
+            unsigned pos = (buf->head + k) % PF_MAX_DEGREE;
+            if(buf->block[pos] != block) {
+                continue;
+            }
+            *late = (buf->ready_time[pos] > cache->now);
+            pf->useless += k;
+            buf->head = (pos + 1) % PF_MAX_DEGREE;
+            buf->count -= k + 1;
+            buf->last_used = cache->now;
+            refillStream(pf, cache, buf);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void allocateStream(prefetcher_t *pf, cache_t *cache, uint64_t block){
+    stream_buffer_t *buf = pf->buffers;
+    for(unsigned i = 1; i < pf->config.streams && buf->count; i++) {
+        if(pf->buffers[i].count == 0 || pf->buffers[i].last_used < buf->last_used) {
+            buf = pf->buffers + i;
+        }
+    }
+    pf->useless += buf->count;
+    buf->head = buf->count = 0;
+    buf->next_block = block + pf->config.distance;
+    buf->last_used = cache->now;
+    refillStream(pf, cache, buf);
+}
+
+static result_t streamAccess(prefetcher_t *pf, cache_t *cache, uint64_t addr){
+    result_t ret = { 0 };
+    uint64_t tag = getTag(cache, addr);
+    set_t *set = getSet(cache, tag);
+    line_t *line;
+    cache->now++;
+    if((line = findLine(cache, set, tag)) != NULL) {
+        list_move_tail(&(line->list), &(set->line_head));
+        ret.hit = true;
+        cache->hit_count++;
+        return ret;
+    }
+    // A stream buffer hit hides the miss, the line still needs a way
+    if(supplyStream(pf, cache, tag, &ret.late)) {
+        ret.hit = ret.prefetch_hit = true;
+        cache->hit_count++;
+    }
+    else {
+        ret.miss = true;
+        cache->miss_count++;
+        allocateStream(pf, cache, tag);
+    }
+    // Lines moved in from a stream buffer are prefetch fills
+    if(addLine(cache, set, tag, false, &ret.victim)) {
+        ret.eviction = true;
+        if(ret.prefetch_hit) {
+            pf->evictions++;
+        }
+        else {
+            cache->eviction_count++;
+        }
+    }
+    return ret;
+}
+
+result_t prefetchAccess(prefetcher_t *pf, cache_t *cache, uint64_t addr){
+    uint64_t tag = getTag(cache, addr);
+    bool polluted = pf->polluted.count && addrMapRemove(&(pf->polluted), tag);
+    result_t ret;
+
+    if(pf->config.kind == PF_STREAM) {
+        ret = streamAccess(pf, cache, addr);
+    }
+    else {
+        ret = accessCache(cache, addr);
+    }
+    if(ret.miss && polluted) {
+        pf->pollution++;
+    }
+    if(ret.eviction && ret.victim.prefetched) {
+        pf->useless++;
+    }
+    if(ret.prefetch_hit) {
+        if(ret.late) {
+            pf->late++;
+        }
+        else {
+            pf->useful++;
+        }
+    }
+
+    switch(pf->config.kind) {
+        case PF_NEXT_LINE: {
+            // Tagged next-line: trigger on misses and first use of prefetched lines
+            if(ret.miss || ret.prefetch_hit) {
+                issueRun(pf, cache, tag, 1);
+            }
+            break;
+        }
+        case PF_STRIDE: {
+            trainStride(pf, cache, addr, tag);
+            break;
+        }
+        default:
+            break;
+    }
+    return ret;
+}
+
+void printPrefetchStats(const prefetcher_t *pf){
+    printf("prefetch(%s): issued:%lu useful:%lu late:%lu useless:%lu pollution:%lu evictions:%lu\n",
+           kind_names[pf->config.kind], pf->issued, pf->useful, pf->late,
+           pf->useless, pf->pollution, pf->evictions);
+}
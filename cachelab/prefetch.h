@@ -0,0 +1,67 @@
+/*
+ * prefetch.h - Hardware prefetcher models feeding the cache model
+ */
+#ifndef CSIM_PREFETCH_H
+#define CSIM_PREFETCH_H
+
+#include "cache.h"
+#include "addrmap.h"
+
+#define PF_MAX_DEGREE 16
+#define PF_MAX_STREAMS 16
+#define PF_STRIDE_ENTRIES 64
+
+typedef enum prefetch_kind{
+    PF_NONE = 0,
+    PF_NEXT_LINE,
+    PF_STRIDE,
+    PF_STREAM
+}prefetch_kind_t;
+
+typedef struct prefetch_config{
+    prefetch_kind_t kind;
+    unsigned degree;   // Blocks requested per trigger
+    unsigned distance; // How many blocks ahead the first request goes
+    unsigned latency;  // Fill latency in demand accesses, 0 means immediate
+    unsigned streams;  // Number of stream buffers
+}prefetch_config_t;
+
+// Stride detector entry, one per tracked 4KB region
+typedef struct stride_entry{
+    uint64_t region;
+    uint64_t last_block;
+    int64_t stride;
+    uint8_t confidence;
+}stride_entry_t;
+
+typedef struct stream_buffer{
+    uint64_t block[PF_MAX_DEGREE];
+    uint64_t ready_time[PF_MAX_DEGREE];
+    unsigned head, count;
+    uint64_t next_block; // Next block to fetch at the tail
+    uint64_t last_used;
+}stream_buffer_t;
+
+typedef struct prefetcher{
+    prefetch_config_t config;
+    // Demand-useful blocks evicted by a prefetch fill, at most one per
+    // line of the cache
+    addrmap_t polluted;
+    uint64_t polluted_cap;
+    stride_entry_t stride_table[PF_STRIDE_ENTRIES];
+    stream_buffer_t buffers[PF_MAX_STREAMS];
+    uint64_t issued, useful, late, useless, pollution;
+    // Evictions by prefetch fills, kept out of the demand counters
+    uint64_t evictions;
+}prefetcher_t;
+
+bool parsePrefetchKind(const char *name, prefetch_kind_t *kind);
+// cache sizes the pollution tracking
+bool initPrefetcher(prefetcher_t *pf, const prefetch_config_t *config, const cache_t *cache);
+void freePrefetcher(prefetcher_t *pf);
+
+// Demand access through the prefetcher, replaces accessCache()
+result_t prefetchAccess(prefetcher_t *pf, cache_t *cache, uint64_t addr);
+void printPrefetchStats(const prefetcher_t *pf);
+
+#endif /* CSIM_PREFETCH_H */
@@ -0,0 +1,207 @@
+/*
+ * sample.c - Approximate simulation by set sampling or time sampling
+ *
+ * Set sampling simulates a fixed, hash-selected subset of the sets and
+ * skips every access that maps elsewhere; a sampled set sees its whole
+ * access stream, so no warm-up is needed. Multiplying by an odd constant
+ * permutes the set numbers, so selecting the sets that land below a
+ * threshold picks exactly that many sets without enumerating them.
+ * Time sampling simulates one unit of accesses per period, preceded by
+ * warm-up accesses that update the cache but are not measured, and skips
+ * the rest.
+ *
+ * Sets carry very uneven load (a few stack sets can take most accesses),
+ * so set samples are extrapolated with the expansion estimator
+ *   Y = S * mean(y),  Var(Y) = S^2 * (1 - f) * var(y) / n
+ * over the S sets. Time units all have the same length, so they use a
+ * ratio estimator of events per access scaled to the full access count,
+ *   Var(R) = (1 - f) / (n * mean(a)^2) * sum((y - R * a)^2) / (n - 1)
+ * Both give a normal 95% confidence interval.
+ */
+#include "sample.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static inline uint64_t mixSet(uint64_t set, uint64_t mask){
+    return (set * 0x9E3779B97F4A7C15UL) & mask;
+}
+
+bool initSampler(sampler_t *sp, const sample_config_t *config, const cache_t *cache){
+    memset(sp, 0, sizeof(sampler_t));
+    sp->config = *config;
+    if(config->mode == SAMPLE_TIME) {
+        if(!config->unit || config->period < config->unit + config->warmup) {
+            fprintf(stderr, "Error: Sample period must cover unit and warm-up\n");
+            return false;
+        }
+        return true;
+    }
+    if(!config->set_ratio) {
+        fprintf(stderr, "Error: Set sampling ratio must be at least 1\n");
+        return false;
+    }
+    sp->set_count = cache->set_mask + 1;
+    // At least one set, even for small caches
+    sp->selected_count = (sp->set_count + config->set_ratio - 1) / config->set_ratio;
+    return initAddrMap(&(sp->slots), 1024);
+}
+
+void freeSampler(sampler_t *sp){
+    free(sp->sets);
+    sp->sets = NULL;
+    if(sp->slots.keys) {
+        freeAddrMap(&(sp->slots));
+    }
+}
+
+static sample_count_t* findSetCount(sampler_t *sp, uint64_t index){
+    bool inserted;
+    uint64_t *slot = addrMapInsert(&(sp->slots), index, sp->set_used, &inserted);
+    if(!slot) {
+        perror("Error: ");
+        exit(EXIT_FAILURE);
+    }
+    if(inserted) {
+        if(sp->set_used == sp->set_alloc) {
+            size_t alloc = sp->set_alloc ? sp->set_alloc * 2 : 1024;
+            sample_count_t *sets = realloc(sp->sets, alloc * sizeof(sample_count_t));
+            if(!sets) {
+                perror("Error: ");
+                exit(EXIT_FAILURE);
+            }
+            sp->sets = sets;
+            sp->set_alloc = alloc;
+        }
+        memset(sp->sets + sp->set_used++, 0, sizeof(sample_count_t));
+    }
+    return sp->sets + *slot;
+}
+
+static void addCluster(ratio_sums_t *sums, double a, double y){
+    sums->n++;
+    sums->a += a;
+    sums->y += y;
+    sums->aa += a * a;
+    sums->yy += y * y;
+    sums->ay += a * y;
+}
+
+static void closeUnit(sampler_t *sp){
+    sample_count_t *unit = &(sp->unit);
+    if(unit->accesses) {
+        addCluster(&(sp->miss_sums), unit->accesses, unit->misses);
+        addCluster(&(sp->eviction_sums), unit->accesses, unit->evictions);
+        sp->units++;
+    }
+    memset(unit, 0, sizeof(sample_count_t));
+}
+
+bool sampleAccess(sampler_t *sp, const cache_t *cache, uint64_t addr, bool *measure){
+    uint64_t position = sp->total++;
+    if(sp->config.mode == SAMPLE_SETS) {
+        uint64_t set = getSetIndex(cache, getTag(cache, addr));
+        *measure = (mixSet(set, cache->set_mask) < sp->selected_count);
+        sp->simulated += *measure;
+        return *measure;
+    }
+    uint64_t phase = position % sp->config.period;
+    uint64_t unit_start = sp->config.period - sp->config.unit;
+    if(phase < unit_start - sp->config.warmup) {
+        return false;
+    }
+    sp->simulated++;
+    *measure = (phase >= unit_start);
+    return true;
+}
+
+void recordSample(sampler_t *sp, const cache_t *cache, uint64_t addr, const result_t *ret){
+    sample_count_t *count;
+    if(sp->config.mode == SAMPLE_SETS) {
+        count = findSetCount(sp, getSetIndex(cache, getTag(cache, addr)));
+    }
+    else {
+        count = &(sp->unit);
+    }
+    count->accesses++;
+    count->hits += ret->hit;
+    count->misses += ret->miss;
+    count->evictions += ret->eviction;
+    if(sp->config.mode == SAMPLE_TIME && count->accesses == sp->config.unit) {
+        closeUnit(sp);
+    }
+}
+
+static estimate_t ratioEstimate(const ratio_sums_t *sums, double fraction, uint64_t total){
+    estimate_t est = { 0, 0 };
+    if(!sums->n || sums->a == 0) {
+        return est;
+    }
+    double ratio = sums->y / sums->a;
+    est.value = ratio * total;
+    if(sums->n > 1) {
+        double mean_a = sums->a / sums->n;
+        double residual = sums->yy - 2 * ratio * sums->ay + ratio * ratio * sums->aa;
+        if(residual < 0) {
+            residual = 0;
+        }
+        double variance = (1 - fraction) / (sums->n * mean_a * mean_a) * residual / (sums->n - 1);
+        est.half_width = 1.96 * sqrt(variance) * total;
+    }
+    return est;
+}
+
+static estimate_t expansionEstimate(const ratio_sums_t *sums, double fraction, uint64_t population){
+    estimate_t est = { 0, 0 };
+    if(!sums->n) {
+        return est;
+    }
+    double mean = sums->y / sums->n;
+    est.value = mean * population;
+    if(sums->n > 1) {
+        double variance = (sums->yy - sums->n * mean * mean) / (sums->n - 1);
+        if(variance < 0) {
+            variance = 0;
+        }
+        est.half_width = 1.96 * population * sqrt((1 - fraction) * variance / sums->n);
+    }
+    return est;
+}
+
+void estimateSample(sampler_t *sp, estimate_t *misses, estimate_t *evictions){
+    ratio_sums_t miss_sums = { 0 }, eviction_sums = { 0 };
+    double fraction;
+    if(sp->config.mode == SAMPLE_SETS) {
+        for(size_t i = 0; i < sp->set_used; i++) {
+            addCluster(&miss_sums, sp->sets[i].accesses, sp->sets[i].misses);
+            addCluster(&eviction_sums, sp->sets[i].accesses, sp->sets[i].evictions);
+        }
+        // Selected sets never touched are clusters with no events
+        miss_sums.n = eviction_sums.n = sp->selected_count;
+        fraction = (double)sp->selected_count / sp->set_count;
+        *misses = expansionEstimate(&miss_sums, fraction, sp->set_count);
+        *evictions = expansionEstimate(&eviction_sums, fraction, sp->set_count);
+        return;
+    }
+    closeUnit(sp);
+    miss_sums = sp->miss_sums;
+    eviction_sums = sp->eviction_sums;
+    fraction = sp->total ? miss_sums.a / sp->total : 1;
+    *misses = ratioEstimate(&miss_sums, fraction, sp->total);
+    *evictions = ratioEstimate(&eviction_sums, fraction, sp->total);
+}
+
+void printSampleStats(sampler_t *sp){
+    estimate_t misses, evictions;
+    estimateSample(sp, &misses, &evictions);
+    if(sp->config.mode == SAMPLE_SETS) {
+        printf("sample(sets %lu/%lu): ", sp->selected_count, sp->set_count);
+    }
+    else {
+        printf("sample(time %lu units): ", sp->units);
+    }
+    printf("accesses:%lu simulated:%lu misses:%.0f+-%.0f evictions:%.0f+-%.0f (95%% CI)\n",
+           sp->total, sp->simulated, misses.value, misses.half_width,
+           evictions.value, evictions.half_width);
+}
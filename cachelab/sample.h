@@ -0,0 +1,66 @@
+/*
+ * sample.h - Set sampling and time sampling with extrapolated totals
+ */
+#ifndef CSIM_SAMPLE_H
+#define CSIM_SAMPLE_H
+
+#include "cache.h"
+
+typedef enum sample_mode{
+    SAMPLE_NONE = 0,
+    SAMPLE_SETS,
+    SAMPLE_TIME
+}sample_mode_t;
+
+// Running sums for a ratio estimator over sampled clusters (sets or units)
+typedef struct ratio_sums{
+    uint64_t n;
+    double a, y, aa, yy, ay; // a: accesses, y: counted events
+}ratio_sums_t;
+
+typedef struct estimate{
+    double value;
+    double half_width; // Of the 95% confidence interval
+}estimate_t;
+
+typedef struct sample_config{
+    sample_mode_t mode;
+    uint64_t set_ratio; // Simulate about one set in set_ratio
+    uint64_t period;    // Time sampling: one unit every period accesses
+    uint64_t unit;      // Measured accesses per unit
+    uint64_t warmup;    // Accesses simulated but not measured before a unit
+}sample_config_t;
+
+// Per-cluster counters
+typedef struct sample_count{
+    uint64_t accesses, hits, misses, evictions;
+}sample_count_t;
+
+typedef struct sampler{
+    sample_config_t config;
+    uint64_t total;     // Every access offered to the sampler
+    uint64_t simulated; // Accesses actually simulated, warm-up included
+    // Set sampling: selection threshold, and counters per touched
+    // selected set found through the slots map
+    uint64_t set_count, selected_count;
+    addrmap_t slots;
+    sample_count_t *sets;
+    size_t set_used, set_alloc;
+    // Time sampling: the open unit and the sums over closed ones
+    sample_count_t unit;
+    ratio_sums_t miss_sums, eviction_sums;
+    uint64_t units;
+}sampler_t;
+
+bool initSampler(sampler_t *sp, const sample_config_t *config, const cache_t *cache);
+void freeSampler(sampler_t *sp);
+
+// Returns false if the access must be skipped; measure tells if it counts
+bool sampleAccess(sampler_t *sp, const cache_t *cache, uint64_t addr, bool *measure);
+void recordSample(sampler_t *sp, const cache_t *cache, uint64_t addr, const result_t *ret);
+
+// Extrapolate totals over all accesses
+void estimateSample(sampler_t *sp, estimate_t *misses, estimate_t *evictions);
+void printSampleStats(sampler_t *sp);
+
+#endif /* CSIM_SAMPLE_H */
@@ -0,0 +1,385 @@
+/*
+ * serve.c - Simulation daemon (csim --serve)
+ *
+ * The trace is read once into an array of packed accesses, then every
+ * query simulates it into a fresh cache of its own, so queries share
+ * nothing but the read-only trace. A fixed pool of workers each block in
+ * accept() on the listening socket and answer one connection at a time;
+ * a connection may send any number of queries, one per line:
+ *
+ *   s=5 E=1 b=5 index=xor prefetch=stride pf-degree=2 region=600000:700000
+ *
+ * Every key is optional where the command line gave a default. Each query
+ * gets one line of JSON back, {"ok":true,...} with the counts, or
+ * {"ok":false,"error":"..."}. The main thread waits for SIGINT or SIGTERM,
+ * then shuts down the listening socket and every open connection, joins
+ * the workers and removes the socket. Connections beyond the pool wait in
+ * the listen backlog.
+ */
+#include "serve.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static bool appendAccess(packed_trace_t *trace, const trace_record_t *rec){
+    if(trace->count == trace->capacity) {
+        size_t capacity = trace->capacity ? trace->capacity * 2 : 4096;
+        packed_access_t *accesses = realloc(trace->accesses, capacity * sizeof(packed_access_t));
+        if(!accesses) {
+            return false;
+        }
+        trace->accesses = accesses;
+        trace->capacity = capacity;
+    }
+    trace->accesses[trace->count++] = (packed_access_t){ rec->addr, (uint32_t)rec->size, rec->op };
+    return true;
+}
+
+bool loadPackedTrace(packed_trace_t *trace, const char *file, unsigned parse_threads, const char *markers){
+    trace_reader_t reader;
+    trace_record_t rec;
+    bool ok = true;
+    memset(trace, 0, sizeof(packed_trace_t));
+    if(!openTraceThreads(&reader, file, parse_threads)) {
+        perror("Error: ");
+        return false;
+    }
+    if(markers) {
+        setTraceMarkers(&reader, markers);
+    }
+    while(ok && nextRecord(&reader, &rec)) {
+        if(!rec.run) {
+            ok = appendAccess(trace, &rec);
+            continue;
+        }
+        for(uint64_t i = 0; ok && i < rec.run->count * rec.run->slots; i++) {
+            trace_record_t access;
+            expandRun(&rec, i, &access, NULL);
+            ok = appendAccess(trace, &access);
+        }
+    }
+    closeTrace(&reader);
+    if(!ok) {
+        perror("Error: ");
+        freePackedTrace(trace);
+    }
+    return ok;
+}
+
+void freePackedTrace(packed_trace_t *trace){
+    free(trace->accesses);
+    trace->accesses = NULL;
+    trace->count = trace->capacity = 0;
+}
+
+static bool parseNumber(const char *text, int base, uint64_t *value){
+    char *end;
+    errno = 0;
+    *value = strtoull(text, &end, base);
+    return *text && !*end && !errno;
+}
+
+const char* parseQuery(char *line, serve_query_t *query){
+    char *save, *token;
+    for(token = strtok_r(line, " \t", &save); token; token = strtok_r(NULL, " \t", &save)) {
+        char *value = strchr(token, '=');
+        uint64_t number;
+        if(!value) {
+            return "expected key=value";
+        }
+        *value++ = '\0';
+        if(!strcmp(token, "region")) {
+            char *hi = strchr(value, ':');
+            if(!hi) {
+                return "region is lo:hi in hex";
+            }
+            *hi++ = '\0';
+            if(!parseNumber(value, 16, &(query->lo)) || !parseNumber(hi, 16, &(query->hi)) ||
+               query->lo >= query->hi) {
+                return "region is lo:hi in hex";
+            }
+        }
+        else if(!strcmp(token, "index")) {
+            if(!parseIndexFunction(value, &(query->index)) || query->index == INDEX_MATRIX) {
+                return "index is modulo, xor or prime";
+            }
+        }
+        else if(!strcmp(token, "prefetch")) {
+            if(!parsePrefetchKind(value, &(query->prefetch.kind))) {
+                return "prefetch is none, next-line, stride or stream";
+            }
+        }
+        else if(!parseNumber(value, 0, &number) || number > UINT32_MAX) {
+            return "bad number";
+        }
+        else if(!strcmp(token, "s")) {
+            query->set_len = (unsigned)number;
+            query->set_len_given = true;
+        }
+        else if(!strcmp(token, "E")) {
+            query->line_size = number;
+            query->line_size_given = true;
+        }
+        else if(!strcmp(token, "b")) {
+            query->block_len = (unsigned)number;
+            query->block_len_given = true;
+        }
+        else if(!strcmp(token, "pf-degree")) {
+            query->prefetch.degree = (unsigned)number;
+        }
+        else if(!strcmp(token, "pf-distance")) {
+            query->prefetch.distance = (unsigned)number;
+        }
+        else if(!strcmp(token, "pf-latency")) {
+            query->prefetch.latency = (unsigned)number;
+        }
+        else if(!strcmp(token, "pf-streams")) {
+            query->prefetch.streams = (unsigned)number;
+        }
+        else {
+            return "unknown key";
+        }
+    }
+    if(!query->set_len_given || !query->line_size_given || !query->block_len_given) {
+        return "missing s, E or b";
+    }
+    return NULL;
+}
+
+static double secondsSince(const struct timespec *start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+void runQuery(const packed_trace_t *trace, const serve_query_t *query, char *reply, size_t len){
+    cache_t cache;
+    prefetcher_t prefetcher;
+    index_config_t index = { .fn = query->index };
+    uint64_t accesses = 0;
+    bool prefetching = query->prefetch.kind != PF_NONE;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(!initCache(&cache, query->set_len, query->line_size, query->block_len)) {
+        snprintf(reply, len, "{\"ok\":false,\"error\":\"invalid cache geometry\"}");
+        return;
+    }
+    if(!setIndexFunction(&cache, &index)) {
+        freeCache(&cache);
+        snprintf(reply, len, "{\"ok\":false,\"error\":\"index function does not fit the geometry\"}");
+        return;
+    }
+    if(prefetching && !initPrefetcher(&prefetcher, &(query->prefetch), &cache)) {
+        freeCache(&cache);
+        snprintf(reply, len, "{\"ok\":false,\"error\":\"invalid prefetcher\"}");
+        return;
+    }
+    for(size_t i = 0; i < trace->count; i++) {
+        const packed_access_t *access = trace->accesses + i;
+        if(access->addr < query->lo || access->addr >= query->hi) {
+            continue;
+        }
+        // A modify is a load and a store of the same block
+        for(int k = (access->op == 'M') ? 2 : 1; k; k--) {
+            // The cache counts demand traffic, the prefetcher its own fills
+            if(prefetching) {
+                prefetchAccess(&prefetcher, &cache, access->addr);
+            }
+            else {
+                accessCache(&cache, access->addr);
+            }
+            accesses++;
+        }
+    }
+    int used = snprintf(reply, len, "{\"ok\":true,\"accesses\":%lu,\"hits\":%lu,\"misses\":%lu,"
+                        "\"evictions\":%lu,\"miss_rate\":%.6f", accesses, cache.hit_count, cache.miss_count,
+                        cache.eviction_count, accesses ? (double)cache.miss_count / accesses : 0);
+    if(prefetching) {
+        used += snprintf(reply + used, len - used, ",\"prefetch_issued\":%lu,\"prefetch_useful\":%lu,"
+                         "\"prefetch_evictions\":%lu", prefetcher.issued, prefetcher.useful, prefetcher.evictions);
+        freePrefetcher(&prefetcher);
+    }
+    snprintf(reply + used, len - used, ",\"seconds\":%.6f}", secondsSince(&start));
+    freeCache(&cache);
+}
+
+typedef struct server{
+    const packed_trace_t *trace;
+    const serve_query_t *defaults;
+    int listen_fd;
+    // Guards stopping and the client of every worker
+    pthread_mutex_t lock;
+    bool stopping;
+}server_t;
+
+typedef struct worker{
+    server_t *server;
+    pthread_t thread;
+    // Connection being answered, -1 while waiting in accept()
+    int client;
+}worker_t;
+
+static void sendReply(int fd, const char *reply){
+    size_t len = strlen(reply);
+    // MSG_NOSIGNAL keeps a client hanging up from raising SIGPIPE
+    while(len) {
+        ssize_t sent = send(fd, reply, len, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if(sent <= 0) {
+            return;
+        }
+        reply += sent;
+        len -= sent;
+    }
+}
+
+static void serveConnection(server_t *server, int fd){
+    FILE *in = fdopen(fd, "r");
+    char line[SERVE_QUERY_MAX], reply[512];
+    if(!in) {
+        close(fd);
+        return;
+    }
+    while(fgets(line, sizeof(line), in)) {
+        char *newline = strchr(line, '\n');
+        if(!newline && !feof(in)) {
+            // Drop the rest of an overlong line
+            int c;
+            while((c = fgetc(in)) != EOF && c != '\n');
+            sendReply(fd, "{\"ok\":false,\"error\":\"query too long\"}\n");
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if(!line[strspn(line, " \t")]) {
+            continue;
+        }
+        serve_query_t query = *(server->defaults);
+        const char *error = parseQuery(line, &query);
+        if(error) {
+            snprintf(reply, sizeof(reply), "{\"ok\":false,\"error\":\"%s\"}", error);
+        }
+        else {
+            runQuery(server->trace, &query, reply, sizeof(reply) - 1);
+        }
+        strcat(reply, "\n");
+        sendReply(fd, reply);
+    }
+    fclose(in);
+}
+
+static void* serveWorker(void *arg){
+    worker_t *worker = arg;
+    server_t *server = worker->server;
+    for(;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if(fd < 0 && (errno == EINTR || errno == ECONNABORTED)) {
+            continue;
+        }
+        pthread_mutex_lock(&(server->lock));
+        // The main thread shut the socket down, or is about to
+        if(fd < 0 || server->stopping) {
+            pthread_mutex_unlock(&(server->lock));
+            if(fd >= 0) {
+                close(fd);
+            }
+            break;
+        }
+        worker->client = fd;
+        pthread_mutex_unlock(&(server->lock));
+        serveConnection(server, fd);
+        pthread_mutex_lock(&(server->lock));
+        worker->client = -1;
+        pthread_mutex_unlock(&(server->lock));
+    }
+    return NULL;
+}
+
+/*
+ * removeStaleSocket - Remove a socket left behind by an earlier daemon,
+ *                     which would fail the bind. Anything else at the
+ *                     path is left alone and fails the start.
+ */
+static bool removeStaleSocket(const char *path){
+    struct stat st;
+    if(lstat(path, &st) < 0) {
+        return errno == ENOENT;
+    }
+    if(!S_ISSOCK(st.st_mode)) {
+        fprintf(stderr, "Error: %s exists and is not a socket\n", path);
+        return false;
+    }
+    return unlink(path) == 0;
+}
+
+bool serveTrace(const packed_trace_t *trace, const serve_query_t *defaults, const char *socket_path,
+                unsigned workers){
+    server_t server = { .trace = trace, .defaults = defaults, .lock = PTHREAD_MUTEX_INITIALIZER };
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    worker_t pool[workers];
+    sigset_t signals;
+    int sig;
+    if(strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", socket_path);
+        return false;
+    }
+    strcpy(addr.sun_path, socket_path);
+    if(!removeStaleSocket(socket_path)) {
+        return false;
+    }
+    if((server.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        perror("Error: ");
+        return false;
+    }
+    if(bind(server.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+       listen(server.listen_fd, (int)workers * 4) < 0) {
+        perror("Error: ");
+        close(server.listen_fd);
+        return false;
+    }
+    // Workers inherit the mask, so only sigwait() below sees the signals
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    unsigned started;
+    for(started = 0; started < workers; started++) {
+        pool[started] = (worker_t){ .server = &server, .client = -1 };
+        if(pthread_create(&(pool[started].thread), NULL, serveWorker, pool + started)) {
+            break;
+        }
+    }
+    if(started) {
+        fprintf(stderr, "csim: serving %zu accesses on %s with %u workers\n", trace->count, socket_path,
+                started);
+        sigwait(&signals, &sig);
+    }
+    // Wake workers in accept() and end their connections, so a worker in
+    // a query finishes it, fails to reply and returns before the trace
+    // is freed
+    pthread_mutex_lock(&(server.lock));
+    server.stopping = true;
+    shutdown(server.listen_fd, SHUT_RDWR);
+    for(unsigned i = 0; i < started; i++) {
+        if(pool[i].client >= 0) {
+            shutdown(pool[i].client, SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&(server.lock));
+    for(unsigned i = 0; i < started; i++) {
+        pthread_join(pool[i].thread, NULL);
+    }
+    close(server.listen_fd);
+    unlink(socket_path);
+    return started == workers;
+}
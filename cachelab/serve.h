@@ -0,0 +1,55 @@
+/*
+ * serve.h - Resident daemon answering simulation queries over a Unix
+ *           domain socket from a trace decoded once
+ */
+#ifndef CSIM_SERVE_H
+#define CSIM_SERVE_H
+
+#include "cache.h"
+#include "prefetch.h"
+
+// Workers answering connections when --workers is not given
+#define SERVE_DEFAULT_WORKERS 4
+// Longest query line
+#define SERVE_QUERY_MAX 1024
+
+// One decoded access. M records stay one entry and count twice.
+typedef struct packed_access{
+    uint64_t addr;
+    uint32_t size;
+    char op;
+}packed_access_t;
+
+typedef struct packed_trace{
+    packed_access_t *accesses;
+    size_t count, capacity;
+}packed_trace_t;
+
+// A what-if query: the cache, its index function and prefetcher, and the
+// address range [lo, hi) whose accesses are simulated
+typedef struct serve_query{
+    unsigned set_len;
+    uint64_t line_size;
+    unsigned block_len;
+    bool set_len_given, line_size_given, block_len_given;
+    index_fn_t index;
+    prefetch_config_t prefetch;
+    uint64_t lo, hi;
+}serve_query_t;
+
+// Decode file once, runs expanded, through the marker region if markers
+// is not NULL
+bool loadPackedTrace(packed_trace_t *trace, const char *file, unsigned parse_threads, const char *markers);
+void freePackedTrace(packed_trace_t *trace);
+
+// Parse "key=value ..." over the defaults already in query. Returns NULL
+// on success, or the error to reply.
+const char* parseQuery(char *line, serve_query_t *query);
+// Simulate query over trace, writing the JSON reply to reply
+void runQuery(const packed_trace_t *trace, const serve_query_t *query, char *reply, size_t len);
+
+// Answer queries on socket_path with workers threads until SIGINT or SIGTERM
+bool serveTrace(const packed_trace_t *trace, const serve_query_t *defaults, const char *socket_path,
+                unsigned workers);
+
+#endif /* CSIM_SERVE_H */
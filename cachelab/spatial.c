@@ -0,0 +1,70 @@
+/*
+ * spatial.c - Spatial utilization of fetched lines
+ *
+ * Every resident line carries a mask of the bytes accessed since it was
+ * filled. When the line is evicted the number of set bits is how much of
+ * the fetch was useful. Lines wider than 64 bytes are tracked in 64
+ * equal granules. A fill whose previous copy left the cache silently
+ * (a prefetch fill evicting it) retires the stale mask first.
+ */
+#include "spatial.h"
+#include <stdio.h>
+#include <string.h>
+
+bool initSpatial(spatial_t *sp, const cache_t *cache){
+    memset(sp, 0, sizeof(spatial_t));
+    sp->bits = cache->block_len > 6 ? 64 : 1U << cache->block_len;
+    sp->granule = cache->block_len > 6 ? 1UL << (cache->block_len - 6) : 1;
+    return initAddrMap(&(sp->touched), 1024);
+}
+
+void freeSpatial(spatial_t *sp){
+    freeAddrMap(&(sp->touched));
+}
+
+static void retireLine(spatial_t *sp, uint64_t tag){
+    uint64_t *mask = addrMapFind(&(sp->touched), tag);
+    if(!mask) {
+        return;
+    }
+    unsigned used = __builtin_popcountl(*mask);
+    sp->lines++;
+    sp->used += used;
+    unsigned bucket = (used * SPATIAL_BUCKETS + sp->bits - 1) / sp->bits;
+    sp->histogram[bucket ? bucket - 1 : 0]++;
+    addrMapRemove(&(sp->touched), tag);
+}
+
+void recordSpatial(spatial_t *sp, const cache_t *cache, uint64_t addr, uint64_t size, const result_t *ret){
+    uint64_t tag = getTag(cache, addr);
+    if(ret->eviction) {
+        retireLine(sp, ret->victim.tag);
+    }
+    if(ret->miss) {
+        retireLine(sp, tag);
+    }
+    uint64_t *mask = addrMapInsert(&(sp->touched), tag, 0, NULL);
+    if(!mask) {
+        perror("Error: ");
+        return;
+    }
+    *mask |= getByteMask(cache, addr, size);
+}
+
+void printSpatialStats(spatial_t *sp){
+    for(size_t i = 0; i < sp->touched.capacity; i++) {
+        if(sp->touched.keys[i] != ADDRMAP_EMPTY) {
+            // Removal shifts a later entry into slot i, look at it again
+            retireLine(sp, sp->touched.keys[i--]);
+        }
+    }
+    double avg = sp->lines ? (double)sp->used * sp->granule / sp->lines : 0;
+    uint64_t line_bytes = sp->bits * sp->granule;
+    printf("spatial: lines:%lu avg-bytes-used:%.1f/%lu (%.1f%%)\n", sp->lines, avg, line_bytes,
+           line_bytes ? 100.0 * avg / line_bytes : 0);
+    printf("spatial-histogram:");
+    for(unsigned i = 0; i < SPATIAL_BUCKETS; i++) {
+        printf(" <=%u/8:%lu", i + 1, sp->histogram[i]);
+    }
+    puts("");
+}
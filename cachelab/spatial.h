@@ -0,0 +1,32 @@
+/*
+ * spatial.h - Spatial utilization: bytes of each fetched line used
+ *             before it leaves the cache
+ */
+#ifndef CSIM_SPATIAL_H
+#define CSIM_SPATIAL_H
+
+#include "cache.h"
+
+// Histogram buckets, by eighths of the line used
+#define SPATIAL_BUCKETS 8
+
+typedef struct spatial{
+    // Block number to the touched mask of every resident line
+    addrmap_t touched;
+    // Bytes per mask bit and mask bits per line (at most 64)
+    uint64_t granule;
+    unsigned bits;
+    // Lines retired and mask bits they had set in total
+    uint64_t lines;
+    uint64_t used;
+    uint64_t histogram[SPATIAL_BUCKETS];
+}spatial_t;
+
+bool initSpatial(spatial_t *sp, const cache_t *cache);
+void freeSpatial(spatial_t *sp);
+
+void recordSpatial(spatial_t *sp, const cache_t *cache, uint64_t addr, uint64_t size, const result_t *ret);
+// Retire the lines still resident and print the utilization report
+void printSpatialStats(spatial_t *sp);
+
+#endif /* CSIM_SPATIAL_H */
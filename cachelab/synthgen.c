@@ -0,0 +1,195 @@
+/*
+ * synthgen.c - Generate synthetic lackey style memory traces
+ *
+ * Writes -n data accesses to stdout following one access pattern over a
+ * footprint of -f bytes starting at -a:
+ *
+ *   seq     consecutive elements, wrapping around the footprint
+ *   stride  every -s bytes, wrapping around the footprint
+ *   random  uniformly random elements
+ *   zipf    elements drawn with Zipfian popularity of exponent -z
+ *   chase   a pointer chase through one random cycle of all elements
+ *
+ * -w is the fraction of accesses that are stores, -k the access size.
+ * The output is deterministic for a given seed (-S).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+typedef enum {
+    PAT_SEQ, PAT_STRIDE, PAT_RANDOM, PAT_ZIPF, PAT_CHASE
+} pattern_t;
+
+static uint64_t rng_state;
+
+/* xorshift64* */
+static uint64_t nextRandom(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DUL;
+}
+
+/* Uniform double in [0, 1) */
+static double nextUniform(void)
+{
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void usage(char *name)
+{
+    printf("Usage: %s [-h] -p <pattern> -n <count> -f <bytes> [options]\n", name);
+    printf("Options:\n");
+    printf("  -p <pattern>  seq, stride, random, zipf or chase\n");
+    printf("  -n <count>    Number of accesses\n");
+    printf("  -f <bytes>    Footprint in bytes\n");
+    printf("  -k <bytes>    Access size (default 8)\n");
+    printf("  -s <bytes>    Stride of the stride pattern (default 64)\n");
+    printf("  -z <alpha>    Zipf exponent (default 1.0)\n");
+    printf("  -w <ratio>    Fraction of stores (default 0)\n");
+    printf("  -a <addr>     Base address in hex (default 10000000)\n");
+    printf("  -S <seed>     Random seed (default 1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    pattern_t pattern = PAT_SEQ;
+    uint64_t count = 0, footprint = 0, size = 8, stride = 64, base = 0x10000000;
+    double alpha = 1.0, write_ratio = 0;
+    char c;
+
+    rng_state = 1;
+    while ((c = getopt(argc, argv, "hp:n:f:k:s:z:w:a:S:")) != -1) {
+        switch (c) {
+        case 'p':
+            if (!strcmp(optarg, "seq"))
+                pattern = PAT_SEQ;
+            else if (!strcmp(optarg, "stride"))
+                pattern = PAT_STRIDE;
+            else if (!strcmp(optarg, "random"))
+                pattern = PAT_RANDOM;
+            else if (!strcmp(optarg, "zipf"))
+                pattern = PAT_ZIPF;
+            else if (!strcmp(optarg, "chase"))
+                pattern = PAT_CHASE;
+            else {
+                printf("Unknown pattern '%s'\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'n':
+            count = strtoull(optarg, NULL, 0);
+            break;
+        case 'f':
+            footprint = strtoull(optarg, NULL, 0);
+            break;
+        case 'k':
+            size = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            stride = strtoull(optarg, NULL, 0);
+            break;
+        case 'z':
+            alpha = atof(optarg);
+            break;
+        case 'w':
+            write_ratio = atof(optarg);
+            break;
+        case 'a':
+            base = strtoull(optarg, NULL, 16);
+            break;
+        case 'S':
+            rng_state = strtoull(optarg, NULL, 0) | 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (!count || !size || footprint < size || !stride) {
+        printf("Error: Missing or invalid argument\n");
+        usage(argv[0]);
+        exit(1);
+    }
+
+    uint64_t elements = footprint / size;
+    uint64_t *next = NULL;   /* chase: successor of each element */
+    double *cdf = NULL;      /* zipf: cumulative popularity by rank */
+
+    if (pattern == PAT_CHASE) {
+        /* Sattolo's algorithm gives a single cycle through every element */
+        next = malloc(elements * sizeof(uint64_t));
+        if (!next) {
+            perror("malloc");
+            exit(1);
+        }
+        for (uint64_t i = 0; i < elements; i++)
+            next[i] = i;
+        for (uint64_t i = elements - 1; i > 0; i--) {
+            uint64_t j = nextRandom() % i;
+            uint64_t t = next[i];
+            next[i] = next[j];
+            next[j] = t;
+        }
+    }
+    if (pattern == PAT_ZIPF) {
+        cdf = malloc(elements * sizeof(double));
+        if (!cdf) {
+            perror("malloc");
+            exit(1);
+        }
+        double sum = 0;
+        for (uint64_t i = 0; i < elements; i++) {
+            sum += 1.0 / pow((double)(i + 1), alpha);
+            cdf[i] = sum;
+        }
+        for (uint64_t i = 0; i < elements; i++)
+            cdf[i] /= sum;
+    }
+
+    uint64_t element = 0, offset = 0;
+    for (uint64_t n = 0; n < count; n++) {
+        switch (pattern) {
+        case PAT_SEQ:
+            element = n % elements;
+            break;
+        case PAT_STRIDE:
+            element = offset / size;
+            offset = (offset + stride) % (elements * size);
+            break;
+        case PAT_RANDOM:
+            element = nextRandom() % elements;
+            break;
+        case PAT_ZIPF: {
+            double u = nextUniform();
+            uint64_t lo = 0, hi = elements - 1;
+            while (lo < hi) {
+                uint64_t mid = (lo + hi) / 2;
+                if (cdf[mid] < u)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            /* Scatter the ranks so hot elements do not share lines */
+            element = (lo * 0x9E3779B97F4A7C15UL) % elements;
+            break;
+        }
+        case PAT_CHASE:
+            element = next[element];
+            break;
+        }
+        char op = (write_ratio > 0 && nextUniform() < write_ratio) ? 'S' : 'L';
+        printf(" %c %lx,%lu\n", op, base + element * size, size);
+    }
+    free(next);
+    free(cdf);
+    return 0;
+}
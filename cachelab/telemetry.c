@@ -0,0 +1,144 @@
+/*
+ * telemetry.c - Interval statistics every N demand accesses
+ *
+ * The simulation thread only fills in a finished interval and pushes it
+ * to a ring buffer; formatting and writing happen on a background thread.
+ *
+ * An interval starts a new phase when its miss ratio or its footprint
+ * (distinct blocks per access) moves away from the mean of the current
+ * phase by more than the threshold, relative to that mean. Comparing
+ * against the phase mean rather than the previous interval keeps slow
+ * drifts from going unnoticed.
+ */
+#include "telemetry.h"
+#include <string.h>
+
+static void* writeIntervals(void *arg){
+    telemetry_t *tm = (telemetry_t*)arg;
+    fputs("interval,start,accesses,hits,misses,evictions,miss_ratio,distinct,distance,phase_change\n", tm->out);
+    pthread_mutex_lock(&(tm->lock));
+    while(true) {
+        while(tm->head == tm->tail && !tm->done) {
+            pthread_cond_wait(&(tm->ready), &(tm->lock));
+        }
+        if(tm->head == tm->tail) {
+            break;
+        }
+        interval_t in = tm->ring[tm->tail % TELEMETRY_RING];
+        tm->tail++;
+        pthread_cond_signal(&(tm->space));
+        pthread_mutex_unlock(&(tm->lock));
+
+        fprintf(tm->out, "%lu,%lu,%lu,%lu,%lu,%lu,%.6f,%lu,%.4f,%d\n", in.index, in.start,
+                in.accesses, in.hits, in.misses, in.evictions,
+                in.accesses ? (double)in.misses / in.accesses : 0.0,
+                in.distinct, in.distance, in.phase_change);
+
+        pthread_mutex_lock(&(tm->lock));
+    }
+    pthread_mutex_unlock(&(tm->lock));
+    fflush(tm->out);
+    return NULL;
+}
+
+bool initTelemetry(telemetry_t *tm, uint64_t period, double threshold, FILE *out){
+    memset(tm, 0, sizeof(telemetry_t));
+    tm->period = period;
+    tm->threshold = threshold;
+    tm->out = out;
+    if(!initAddrMap(&(tm->blocks), period < 4096 ? period : 4096)) {
+        return false;
+    }
+    pthread_mutex_init(&(tm->lock), NULL);
+    pthread_cond_init(&(tm->ready), NULL);
+    pthread_cond_init(&(tm->space), NULL);
+    if(pthread_create(&(tm->writer), NULL, writeIntervals, tm) != 0) {
+        freeAddrMap(&(tm->blocks));
+        return false;
+    }
+    return true;
+}
+
+static inline double relativeChange(double value, double mean){
+    double diff = value > mean ? value - mean : mean - value;
+    // Avoid flagging noise around a near-zero mean
+    return diff / (mean > 0.001 ? mean : 0.001);
+}
+
+static void pushInterval(telemetry_t *tm){
+    interval_t *in = &(tm->current);
+    in->index = tm->intervals++;
+    in->distinct = tm->blocks.count;
+    if(tm->threshold > 0) {
+        double miss_ratio = (double)in->misses / in->accesses;
+        double density = (double)in->distinct / in->accesses;
+        if(!tm->phase_length) {
+            in->phase_change = true;
+        }
+        else {
+            double miss_change = relativeChange(miss_ratio, tm->phase_miss_ratio);
+            double density_change = relativeChange(density, tm->phase_density);
+            in->distance = miss_change > density_change ? miss_change : density_change;
+            in->phase_change = (in->distance > tm->threshold);
+        }
+        if(in->phase_change) {
+            tm->phase_length = 0;
+            tm->phase_miss_ratio = tm->phase_density = 0;
+            tm->phases++;
+        }
+        // Running mean over the intervals of the phase
+        tm->phase_length++;
+        tm->phase_miss_ratio += (miss_ratio - tm->phase_miss_ratio) / tm->phase_length;
+        tm->phase_density += (density - tm->phase_density) / tm->phase_length;
+    }
+
+    pthread_mutex_lock(&(tm->lock));
+    while(tm->head - tm->tail == TELEMETRY_RING) {
+        pthread_cond_wait(&(tm->space), &(tm->lock));
+    }
+    tm->ring[tm->head % TELEMETRY_RING] = *in;
+    tm->head++;
+    pthread_cond_signal(&(tm->ready));
+    pthread_mutex_unlock(&(tm->lock));
+
+    uint64_t next = in->start + in->accesses;
+    memset(in, 0, sizeof(interval_t));
+    in->start = next;
+    clearAddrMap(&(tm->blocks));
+}
+
+void recordTelemetry(telemetry_t *tm, uint64_t tag, const result_t *ret){
+    interval_t *in = &(tm->current);
+    in->accesses++;
+    in->hits += ret->hit;
+    in->misses += ret->miss;
+    in->evictions += ret->eviction;
+    addrMapInsert(&(tm->blocks), tag, 0, NULL);
+    if(in->accesses == tm->period) {
+        pushInterval(tm);
+    }
+}
+
+void finishTelemetry(telemetry_t *tm){
+    if(tm->current.accesses) {
+        pushInterval(tm);
+    }
+    pthread_mutex_lock(&(tm->lock));
+    tm->done = true;
+    pthread_cond_signal(&(tm->ready));
+    pthread_mutex_unlock(&(tm->lock));
+    pthread_join(tm->writer, NULL);
+    pthread_mutex_destroy(&(tm->lock));
+    pthread_cond_destroy(&(tm->ready));
+    pthread_cond_destroy(&(tm->space));
+    freeAddrMap(&(tm->blocks));
+}
+
+void printTelemetryStats(const telemetry_t *tm){
+    if(tm->threshold > 0) {
+        printf("telemetry: intervals:%lu phases:%lu\n", tm->intervals, tm->phases);
+    }
+    else {
+        printf("telemetry: intervals:%lu\n", tm->intervals);
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * telemetry.h - Interval statistics and phase detection
+ */
+#ifndef CSIM_TELEMETRY_H
+#define CSIM_TELEMETRY_H
+
+#include "cache.h"
+#include "addrmap.h"
+#include <stdio.h>
+#include <pthread.h>
+
+#define TELEMETRY_RING 256
+
+typedef struct interval{
+    uint64_t index;
+    uint64_t start; // Access number the interval starts at
+    uint64_t accesses, hits, misses, evictions;
+    uint64_t distinct; // Distinct blocks touched
+    double distance;   // Relative behaviour change against the current phase
+    bool phase_change;
+}interval_t;
+
+typedef struct telemetry{
+    uint64_t period;
+    double threshold; // Phase change threshold, 0 disables detection
+    FILE *out;
+
+    interval_t current;
+    addrmap_t blocks;
+    // Mean miss ratio and distinct blocks per access of the current phase
+    double phase_miss_ratio, phase_density;
+    uint64_t phase_length;
+    uint64_t intervals, phases;
+
+    // Single producer ring drained by the writer thread
+    interval_t ring[TELEMETRY_RING];
+    size_t head, tail;
+    bool done;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    pthread_t writer;
+}telemetry_t;
+
+bool initTelemetry(telemetry_t *tm, uint64_t period, double threshold, FILE *out);
+// Flush the last partial interval and stop the writer thread
+void finishTelemetry(telemetry_t *tm);
+
+void recordTelemetry(telemetry_t *tm, uint64_t tag, const result_t *ret);
+void printTelemetryStats(const telemetry_t *tm);
+
+#endif /* CSIM_TELEMETRY_H */
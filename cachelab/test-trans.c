@@ -12,6 +12,8 @@
 #include <getopt.h>
 #include <sys/types.h>
 #include "cachelab.h"
+#include "order.h"
+#include "elemtrans.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
 
@@ -41,6 +43,112 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
+/* Latencies given with -L, and the projected cycles of each function */
+static char *latency = NULL;
+static unsigned long long int cycles[MAX_TRANS_FUNCS];
+
+/* Also evaluate the blocked and Morton order transposes, with -l */
+static int orders = 0;
+
+/* Also evaluate the transposes of other element types, with -e */
+static int elems = 0;
+
+/* Layout sweep given with -S: row pads 0..sweep_pad, sweep_offsets B offsets */
+static int sweep_pad = -1;
+static int sweep_offsets = 1;
+
+/*
+ * remap_trace - Copy a trace, moving the accesses to A and B from where
+ *     tracegen put them to the layout given by their new starts and
+ *     leading dimensions. Transposes do not branch on addresses, so this
+ *     is the trace the kernel would give run on that layout. Both
+ *     matrices must be row-major.
+ */
+static void remap_trace(const char *in_name, const char *out_name,
+                        unsigned long long int a_old, unsigned long long int b_old,
+                        unsigned long long int a_new, unsigned long long int b_new,
+                        int lda, int ldb, size_t size)
+{
+    char buf[1000];
+    unsigned long long int addr, off;
+    unsigned int len;
+    FILE *in_fp = fopen(in_name, "r");
+    FILE *out_fp = fopen(out_name, "w");
+    assert(in_fp && out_fp);
+
+    while (fgets(buf, 1000, in_fp) != NULL) {
+        if (buf[0] != ' ' || sscanf(buf+3, "%llx,%u", &addr, &len) != 2) {
+            fputs(buf, out_fp);
+            continue;
+        }
+        if (addr >= a_old && addr < a_old + size * M * N) {
+            off = addr - a_old;
+            addr = a_new + size * (off / size / M * lda + off / size % M) + off % size;
+        }
+        else if (addr >= b_old && addr < b_old + size * M * N) {
+            off = addr - b_old;
+            addr = b_new + size * (off / size / N * ldb + off / size % N) + off % size;
+        }
+        fprintf(out_fp, " %c %llx,%u\n", buf[1], addr, len);
+    }
+    fclose(in_fp);
+    fclose(out_fp);
+}
+
+/*
+ * sweep_layouts - Simulate the trace of function i with the rows of A and
+ *     B padded by 0..sweep_pad ints and B moved by 0..sweep_offsets-1
+ *     blocks, reporting the misses of each layout
+ */
+static void sweep_layouts(int i, unsigned int s, unsigned int E, unsigned int b)
+{
+    unsigned long long int a_old, a_end, b_old, b_end;
+    unsigned int hits, misses, evictions;
+    unsigned int base_misses = 0, best_misses = UINT_MAX;
+    layout_t best = { 0 };
+    char cmd[255], filename[128];
+
+    /* tracegen ran with the default layout, so its arena starts at A */
+    FILE *regions_fp = fopen(".regions", "r");
+    assert(regions_fp);
+    fscanf(regions_fp, "A %llx %llx\nB %llx %llx", &a_old, &a_end, &b_old, &b_end);
+    fclose(regions_fp);
+
+    printf("Step 3: Sweeping layouts of func %d (pads 0..%d, %d B offsets)\n",
+           i, sweep_pad, sweep_offsets);
+    sprintf(filename, "trace.f%d", i);
+    for (int k = 0; k < sweep_offsets; k++) {
+        for (int a_pad = 0; a_pad <= sweep_pad; a_pad++) {
+            for (int b_pad = 0; b_pad <= sweep_pad; b_pad++) {
+                layout_t layout = { 0, (unsigned long)k << b, DEFAULT_LAYOUT_ALIGN, a_pad, b_pad };
+                unsigned long a_start, b_start;
+                layoutMatrices(&layout, M, N, func_list[i].elem_size, &a_start, &b_start);
+                remap_trace(filename, "trace.layout", a_old, b_old,
+                            a_old + a_start, a_old + b_start, M + a_pad, N + b_pad,
+                            func_list[i].elem_size);
+                sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.layout > /dev/null", s, E, b);
+                system(cmd);
+                FILE *in_fp = fopen(".csim_results", "r");
+                assert(in_fp);
+                fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
+                fclose(in_fp);
+                printf("layout b_offset:%lu pad:%d,%d hits:%u, misses:%u, evictions:%u\n",
+                       layout.b_offset, a_pad, b_pad, hits, misses, evictions);
+                if (!k && !a_pad && !b_pad)
+                    base_misses = misses;
+                if (misses < best_misses) {
+                    best_misses = misses;
+                    best = layout;
+                }
+            }
+        }
+    }
+    printf("func %d (%s): best layout b_offset:%lu pad:%d,%d with %u misses (%u unpadded)\n",
+           i, func_list[i].description, best.b_offset, best.a_pad, best.b_pad,
+           best_misses, base_misses);
+    remove("trace.layout");
+}
+
 /* 
  * eval_perf - Evaluate the performance of the registered transpose functions
  */
@@ -53,6 +161,10 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
     char filename[128];
 
     registerFunctions(); 
+    if (orders)
+        registerOrderFunctions();
+    if (elems)
+        registerElemFunctions();
 
     /* Open the complete trace file */
     FILE* full_trace_fp;  
@@ -68,7 +180,7 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
         printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
         /* Use valgrind to generate the trace */
 
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
+        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d %s %s > trace.tmp", M, N,i, orders ? "-l" : "", elems ? "-e" : "");
         flag=WEXITSTATUS(system(cmd));
         if (0!=flag) {
             printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
@@ -151,24 +263,71 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
         func_list[i].num_evictions = evictions;
         printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
                i, func_list[i].description, hits, misses, evictions);
+        /* Bytes moved per miss compares functions across element types */
+        if (elems)
+            printf("func %u (%s): element:%luB, bytes/miss:%.1f\n", i, func_list[i].description,
+                   func_list[i].elem_size,
+                   misses ? 2.0 * M * N * func_list[i].elem_size / misses : 0.0);
     
         /* If it is transpose_submit(), record number of misses */
         if (results.funcid == i) {
             results.misses = misses;
         }
+
+        /* Project the running time with the latency model of csim */
+        if (latency) {
+            double amat;
+            sprintf(cmd, "./csim -s %u -E %u -b %u -t trace.f%d --latency %s > /dev/null",
+                    s, E, b, i, latency);
+            system(cmd);
+            in_fp = fopen(".csim_latency", "r");
+            assert(in_fp);
+            fscanf(in_fp, "%llu %lf", &cycles[i], &amat);
+            fclose(in_fp);
+            printf("func %u (%s): projected cycles:%llu, amat:%.2f\n",
+                   i, func_list[i].description, cycles[i], amat);
+        }
+
+        /* Padding only means something for row-major matrices */
+        if (sweep_pad >= 0 && func_list[i].order == ORDER_ROW_MAJOR)
+            sweep_layouts(i, s, E, b);
+        else if (sweep_pad >= 0)
+            printf("Step 3: Skipping layout sweep of func %d, B is not row-major\n", i);
+    }
+
+    /* Rank the correct functions by projected cycles */
+    if (latency) {
+        int order[MAX_TRANS_FUNCS], count = 0;
+        for (i=0; i<func_counter; i++) {
+            if (!func_list[i].correct)
+                continue;
+            int j = count++;
+            for (; j > 0 && cycles[order[j-1]] > cycles[i]; j--)
+                order[j] = order[j-1];
+            order[j] = i;
+        }
+        printf("\nRanking by projected cycles (latency %s):\n", latency);
+        for (i=0; i<count; i++)
+            printf("%2d. func %d (%s): %llu cycles, %u misses\n", i+1, order[i],
+                   func_list[order[i]].description, cycles[order[i]],
+                   func_list[order[i]].num_misses);
     }
-  
 }
 
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-h] -M <rows> -N <cols> [-L <hit,mem>] [-S <pad>[,<offsets>]] [-l] [-e]\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
+    printf("  -L <hit,mem> Also rank functions by cycles projected by ./csim\n");
+    printf("  -S <pad>[,<offsets>] Also report misses with rows padded by 0..pad ints\n");
+    printf("              and B moved by 0..offsets-1 blocks\n");
+    printf("  -l          Also evaluate the blocked and Morton order transposes\n");
+    printf("  -e          Also evaluate transposes of 1, 2, 4, 8 and 16 byte elements\n");
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
 }
 
@@ -199,7 +358,7 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:L:S:leh")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -207,6 +366,18 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 'L':
+            latency = optarg;
+            break;
+        case 'S':
+            sscanf(optarg, "%d,%d", &sweep_pad, &sweep_offsets);
+            break;
+        case 'l':
+            orders = 1;
+            break;
+        case 'e':
+            elems = 1;
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -222,6 +393,12 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    if (sweep_pad > 64 || sweep_offsets < 1) {
+        printf("Error: Sweep pads must be at most 64 and offsets positive\n");
+        usage(argv);
+        exit(1);
+    }
+
     if (M > MAXN || N > MAXN) {
         printf("Error: M or N exceeds %d\n", MAXN);
         usage(argv);
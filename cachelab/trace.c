@@ -0,0 +1,735 @@
+/*
+ * trace.c - Reader for valgrind lackey style memory traces
+ *
+ * The sequential reader goes line by line through stdio. The chunked
+ * reader maps the file and lets worker threads decode CHUNK_BYTES pieces
+ * of it into packed record buffers. A chunk owns the lines that start
+ * inside it, so a line crossing the chunk end is decoded whole by the
+ * chunk it started in. Buffers are bound to the slots of a ring of
+ * 2 * threads chunks: a worker may only take a chunk whose slot the
+ * consumer has finished with, which keeps records in trace order and
+ * memory bounded by the ring.
+ *
+ * Pipes and FIFOs are read by a thread into two STREAM_BYTES buffers
+ * while the simulation consumes the other one. The thread only hands
+ * over whole lines, carrying a partial last line into the next buffer.
+ */
+#include "trace.h"
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CHUNK_BYTES (1UL << 20)
+#define STREAM_BYTES (4UL << 20)
+// eval_perf() drops accesses above the low 4GB (valgrind's own stack)
+#define MARKER_ADDR_LIMIT 0xffffffffUL
+
+// A decoded record and where its text sits in the mapped trace
+typedef struct packed_record{
+    uint64_t addr;
+    uint64_t size;
+    uint64_t time;
+    uint64_t text;
+    uint32_t core;
+    uint32_t text_len;
+    char op;
+    bool timed;
+}packed_record_t;
+
+typedef struct record_buffer{
+    packed_record_t *records;
+    size_t count, capacity;
+    bool ready;
+}record_buffer_t;
+
+typedef struct chunk_parser{
+    const char *data;
+    size_t size;
+    uint64_t chunks;
+    unsigned threads, slots;
+    pthread_t *workers;
+    record_buffer_t *buffers;
+    pthread_mutex_t lock;
+    pthread_cond_t space, ready;
+    // Next chunk to hand to a worker, and the chunk being consumed
+    uint64_t next_chunk, current;
+    // Whether the consumer holds the current chunk, and its next record
+    bool acquired;
+    size_t pos;
+    bool stop;
+}chunk_parser_t;
+
+typedef struct stream_half{
+    char *data;
+    size_t len;
+    bool full;
+}stream_half_t;
+
+typedef struct stream_reader{
+    int fd;
+    pthread_t thread;
+    stream_half_t halves[2];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // The thread delivered its last buffer
+    bool done;
+    // Set by closeStream(), which also writes to wake to end a read wait
+    bool stop;
+    int wake[2];
+    // Half being consumed, whether the consumer holds it, and its position
+    unsigned current;
+    bool acquired;
+    size_t pos;
+    struct timespec opened;
+}stream_reader_t;
+
+static const char* skipSpaces(const char *p, const char *end){
+    while(p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+static int hexDigit(char c){
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+static const char* parseHex(const char *p, const char *end, uint64_t *value){
+    if(end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' && hexDigit(p[2]) >= 0) {
+        p += 2;
+    }
+    *value = 0;
+    for(int d; p < end && (d = hexDigit(*p)) >= 0; p++) {
+        *value = (*value << 4) | d;
+    }
+    return p;
+}
+
+static const char* parseDecimal(const char *p, const char *end, uint64_t *value){
+    *value = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+        *value = *value * 10 + (*p - '0');
+    }
+    return p;
+}
+
+// Decode "<count> <op> <addr>,<size> <stride> ..." following the 'R'
+static bool parseRun(const char *p, const char *end, trace_run_t *run){
+    const char *q;
+    p = skipSpaces(p, end);
+    q = parseDecimal(p, end, &(run->count));
+    if(q == p || !run->count) {
+        return false;
+    }
+    for(run->slots = 0, p = skipSpaces(q, end); p < end; p = skipSpaces(p, end)) {
+        run_slot_t *slot = run->slot + run->slots;
+        uint64_t stride;
+        bool negative;
+        if(run->slots == RUN_MAX_SLOTS) {
+            return false;
+        }
+        slot->op = *p++;
+        if(slot->op != 'L' && slot->op != 'S' && slot->op != 'M') {
+            return false;
+        }
+        p = skipSpaces(p, end);
+        if(p == end || hexDigit(*p) < 0) {
+            return false;
+        }
+        p = parseHex(p, end, &(slot->addr));
+        if(p == end || *p != ',') {
+            return false;
+        }
+        p = parseDecimal(p + 1, end, &(slot->size));
+        p = skipSpaces(p, end);
+        negative = (p < end && *p == '-');
+        if(p < end && (*p == '-' || *p == '+')) {
+            p++;
+        }
+        if(p == end || *p < '0' || *p > '9') {
+            return false;
+        }
+        p = parseDecimal(p, end, &stride);
+        slot->stride = negative ? -(int64_t)stride : (int64_t)stride;
+        run->slots++;
+    }
+    return run->slots > 0;
+}
+
+/*
+ * parseLine - Decode the line [p, end). Returns false for lines that are
+ *             not data accesses, or instruction fetches when fetches is
+ *             set. timed tells whether it had a timestamp. A run line
+ *             decodes into run and gives op 'R'.
+ */
+static bool parseLine(const char *p, const char *end, trace_record_t *rec, bool *timed, trace_run_t *run,
+                      bool fetches){
+    rec->run = NULL;
+    if(p < end && *p == 'R') {
+        if(!parseRun(p + 1, end, run)) {
+            return false;
+        }
+        rec->op = 'R';
+        rec->addr = run->slot[0].addr;
+        rec->size = run->slot[0].size;
+        rec->core = 0;
+        rec->run = run;
+        *timed = false;
+        return true;
+    }
+    // Instruction fetches and blank lines do not start with a space
+    if(p == end || (*p != ' ' && (*p != 'I' || !fetches))) {
+        return false;
+    }
+    p = skipSpaces(p, end);
+    if(p == end) {
+        return false;
+    }
+    rec->op = *p++;
+    p = skipSpaces(p, end);
+    if(p == end || (hexDigit(*p) < 0)) {
+        return false;
+    }
+    p = parseHex(p, end, &(rec->addr));
+    rec->size = 0;
+    rec->core = 0;
+    *timed = false;
+    if(p < end && *p == ',') {
+        p = skipSpaces(p + 1, end);
+        for(; p < end && *p >= '0' && *p <= '9'; p++) {
+            rec->size = rec->size * 10 + (*p - '0');
+        }
+    }
+    // Optional fields: a timestamp and a t<core> thread/core id
+    while(p < end) {
+        if(*p == 't' && p + 1 < end && p[1] >= '0' && p[1] <= '9') {
+            rec->core = 0;
+            for(p++; p < end && *p >= '0' && *p <= '9'; p++) {
+                rec->core = rec->core * 10 + (*p - '0');
+            }
+        }
+        else if(*p >= '0' && *p <= '9') {
+            rec->time = 0;
+            for(; p < end && *p >= '0' && *p <= '9'; p++) {
+                rec->time = rec->time * 10 + (*p - '0');
+            }
+            *timed = true;
+        }
+        else {
+            p++;
+        }
+    }
+    return true;
+}
+
+static void decodeChunk(chunk_parser_t *parser, uint64_t chunk, record_buffer_t *buf){
+    const char *data = parser->data, *limit = data + parser->size;
+    const char *p = data + chunk * CHUNK_BYTES;
+    const char *chunk_end = (parser->size - chunk * CHUNK_BYTES > CHUNK_BYTES) ? p + CHUNK_BYTES : limit;
+    // The line in progress at the chunk start belongs to the chunk before
+    if(chunk && p[-1] != '\n') {
+        const char *nl = memchr(p, '\n', limit - p);
+        p = nl ? nl + 1 : limit;
+    }
+    buf->count = 0;
+    while(p < chunk_end) {
+        const char *nl = memchr(p, '\n', limit - p);
+        const char *end = nl ? nl : limit;
+        const char *text_end = end;
+        trace_record_t rec;
+        trace_run_t run;
+        bool timed;
+        while(text_end > p && text_end[-1] == '\r') {
+            text_end--;
+        }
+        if(parseLine(p, text_end, &rec, &timed, &run, true)) {
+            if(buf->count == buf->capacity) {
+                size_t capacity = buf->capacity ? buf->capacity * 2 : 4096;
+                packed_record_t *records = realloc(buf->records, capacity * sizeof(packed_record_t));
+                if(!records) {
+                    perror("Error: ");
+                    exit(EXIT_FAILURE);
+                }
+                buf->records = records;
+                buf->capacity = capacity;
+            }
+            packed_record_t *out = buf->records + buf->count++;
+            out->addr = rec.addr;
+            out->size = rec.size;
+            out->time = timed ? rec.time : 0;
+            out->core = rec.core;
+            out->op = rec.op;
+            out->timed = timed;
+            out->text = p - data;
+            out->text_len = text_end - p;
+        }
+        p = end + 1;
+    }
+}
+
+static void* decodeWorker(void *arg){
+    chunk_parser_t *parser = arg;
+    pthread_mutex_lock(&(parser->lock));
+    while(true) {
+        while(!parser->stop && parser->next_chunk < parser->chunks &&
+              parser->next_chunk >= parser->current + parser->slots) {
+            pthread_cond_wait(&(parser->space), &(parser->lock));
+        }
+        if(parser->stop || parser->next_chunk >= parser->chunks) {
+            break;
+        }
+        uint64_t chunk = parser->next_chunk++;
+        record_buffer_t *buf = parser->buffers + chunk % parser->slots;
+        pthread_mutex_unlock(&(parser->lock));
+        decodeChunk(parser, chunk, buf);
+        pthread_mutex_lock(&(parser->lock));
+        buf->ready = true;
+        pthread_cond_broadcast(&(parser->ready));
+    }
+    pthread_mutex_unlock(&(parser->lock));
+    return NULL;
+}
+
+static void stopParser(chunk_parser_t *parser){
+    pthread_mutex_lock(&(parser->lock));
+    parser->stop = true;
+    pthread_cond_broadcast(&(parser->space));
+    pthread_mutex_unlock(&(parser->lock));
+    for(unsigned i = 0; i < parser->threads; i++) {
+        pthread_join(parser->workers[i], NULL);
+    }
+    for(unsigned i = 0; i < parser->slots; i++) {
+        free(parser->buffers[i].records);
+    }
+    pthread_mutex_destroy(&(parser->lock));
+    pthread_cond_destroy(&(parser->space));
+    pthread_cond_destroy(&(parser->ready));
+    munmap((void*)parser->data, parser->size);
+    free(parser->buffers);
+    free(parser->workers);
+    free(parser);
+}
+
+// Wait until the trace can be read, false once closeStream() stops the thread
+static bool waitReadable(stream_reader_t *stream){
+    struct pollfd fds[2] = { { stream->fd, POLLIN, 0 }, { stream->wake[0], POLLIN, 0 } };
+    while(poll(fds, 2, -1) < 0) {
+        if(errno != EINTR) {
+            return false;
+        }
+    }
+    return !fds[1].revents;
+}
+
+static void* streamWorker(void *arg){
+    stream_reader_t *stream = arg;
+    char *carry = malloc(STREAM_BYTES);
+    size_t carry_len = 0;
+    unsigned i = 0;
+    bool eof = !carry;
+    while(!eof) {
+        stream_half_t *half = stream->halves + i;
+        bool stop;
+        pthread_mutex_lock(&(stream->lock));
+        while(half->full && !stream->stop) {
+            pthread_cond_wait(&(stream->cond), &(stream->lock));
+        }
+        stop = stream->stop;
+        pthread_mutex_unlock(&(stream->lock));
+        if(stop) {
+            break;
+        }
+
+        size_t len = carry_len;
+        memcpy(half->data, carry, carry_len);
+        while(len < STREAM_BYTES) {
+            if(!waitReadable(stream)) {
+                stop = eof = true;
+                break;
+            }
+            ssize_t n = read(stream->fd, half->data + len, STREAM_BYTES - len);
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0) {
+                eof = true;
+                break;
+            }
+            len += n;
+        }
+        if(stop) {
+            break;
+        }
+        carry_len = 0;
+        if(!eof) {
+            // Keep the partial last line for the next buffer
+            size_t keep = len;
+            while(keep && half->data[keep - 1] != '\n') {
+                keep--;
+            }
+            if(keep) {
+                carry_len = len - keep;
+                memcpy(carry, half->data + keep, carry_len);
+                len = keep;
+            }
+        }
+        pthread_mutex_lock(&(stream->lock));
+        half->len = len;
+        half->full = true;
+        stream->done = eof;
+        pthread_cond_broadcast(&(stream->cond));
+        pthread_mutex_unlock(&(stream->lock));
+        i ^= 1;
+    }
+    if(!carry) {
+        pthread_mutex_lock(&(stream->lock));
+        stream->done = true;
+        pthread_cond_broadcast(&(stream->cond));
+        pthread_mutex_unlock(&(stream->lock));
+    }
+    free(carry);
+    return NULL;
+}
+
+static void freeStream(stream_reader_t *stream){
+    free(stream->halves[0].data);
+    free(stream->halves[1].data);
+    close(stream->wake[0]);
+    close(stream->wake[1]);
+    pthread_mutex_destroy(&(stream->lock));
+    pthread_cond_destroy(&(stream->cond));
+    if(stream->fd != STDIN_FILENO) {
+        close(stream->fd);
+    }
+    free(stream);
+}
+
+static bool openStream(trace_reader_t *reader, int fd){
+    stream_reader_t *stream = calloc(1, sizeof(stream_reader_t));
+    if(!stream) {
+        return false;
+    }
+    stream->fd = fd;
+    clock_gettime(CLOCK_REALTIME, &(stream->opened));
+    pthread_mutex_init(&(stream->lock), NULL);
+    pthread_cond_init(&(stream->cond), NULL);
+    if(pipe(stream->wake) < 0) {
+        stream->wake[0] = stream->wake[1] = -1;
+        freeStream(stream);
+        return false;
+    }
+    if(!(stream->halves[0].data = malloc(STREAM_BYTES)) || !(stream->halves[1].data = malloc(STREAM_BYTES)) ||
+       pthread_create(&(stream->thread), NULL, streamWorker, stream)) {
+        freeStream(stream);
+        return false;
+    }
+    reader->stream = stream;
+    return true;
+}
+
+static void closeStream(stream_reader_t *stream){
+    // Stopped early, the thread may wait for a free half or on the writer
+    pthread_mutex_lock(&(stream->lock));
+    stream->stop = true;
+    pthread_cond_broadcast(&(stream->cond));
+    pthread_mutex_unlock(&(stream->lock));
+    if(write(stream->wake[1], "", 1) < 0) {
+        perror("Error: ");
+    }
+    pthread_join(stream->thread, NULL);
+    freeStream(stream);
+}
+
+bool openTrace(trace_reader_t *reader, const char *file){
+    struct stat st;
+    int fd = strcmp(file, "-") ? open(file, O_RDONLY) : STDIN_FILENO;
+    memset(reader, 0, sizeof(trace_reader_t));
+    if(fd < 0 || fstat(fd, &st) < 0) {
+        return false;
+    }
+    if(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISCHR(st.st_mode)) {
+        return openStream(reader, fd);
+    }
+    return (reader->fptr = fdopen(fd, "r")) != NULL;
+}
+
+bool openTraceThreads(trace_reader_t *reader, const char *file, unsigned threads){
+    struct stat st;
+    int fd;
+    if(!threads || !strcmp(file, "-") || (fd = open(file, O_RDONLY)) < 0) {
+        return openTrace(reader, file);
+    }
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !st.st_size) {
+        close(fd);
+        return openTrace(reader, file);
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return openTrace(reader, file);
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    chunk_parser_t *parser = calloc(1, sizeof(chunk_parser_t));
+    if(!parser) {
+        munmap(data, st.st_size);
+        return false;
+    }
+    parser->data = data;
+    parser->size = st.st_size;
+    parser->chunks = (st.st_size + CHUNK_BYTES - 1) / CHUNK_BYTES;
+    parser->threads = threads;
+    parser->slots = 2 * threads;
+    parser->workers = calloc(threads, sizeof(pthread_t));
+    parser->buffers = calloc(parser->slots, sizeof(record_buffer_t));
+    pthread_mutex_init(&(parser->lock), NULL);
+    pthread_cond_init(&(parser->space), NULL);
+    pthread_cond_init(&(parser->ready), NULL);
+    memset(reader, 0, sizeof(trace_reader_t));
+    reader->parser = parser;
+    if(!parser->workers || !parser->buffers) {
+        parser->threads = 0;
+        stopParser(parser);
+        reader->parser = NULL;
+        return false;
+    }
+    for(unsigned i = 0; i < threads; i++) {
+        if(pthread_create(parser->workers + i, NULL, decodeWorker, parser)) {
+            parser->threads = i;
+            stopParser(parser);
+            reader->parser = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+void closeTrace(trace_reader_t *reader){
+    if(reader->fptr) {
+        fclose(reader->fptr);
+        reader->fptr = NULL;
+    }
+    if(reader->parser) {
+        stopParser(reader->parser);
+        reader->parser = NULL;
+    }
+    if(reader->stream) {
+        closeStream(reader->stream);
+        reader->stream = NULL;
+    }
+}
+
+static bool loadMarkers(trace_reader_t *reader){
+    marker_filter_t *markers = &(reader->markers);
+    struct stat st;
+    if(stat(markers->file, &st) < 0) {
+        return false;
+    }
+    // A streamed trace must not pick up the markers of an earlier run
+    if(reader->stream) {
+        const struct timespec *opened = &(reader->stream->opened);
+        if(st.st_mtim.tv_sec < opened->tv_sec ||
+           (st.st_mtim.tv_sec == opened->tv_sec && st.st_mtim.tv_nsec < opened->tv_nsec)) {
+            return false;
+        }
+    }
+    FILE *fptr = fopen(markers->file, "r");
+    if(!fptr) {
+        return false;
+    }
+    markers->loaded = (fscanf(fptr, "%lx %lx", &(markers->start), &(markers->end)) == 2);
+    fclose(fptr);
+    return markers->loaded;
+}
+
+void setTraceFetches(trace_reader_t *reader, bool fetches){
+    reader->fetches = fetches;
+}
+
+void setTraceMarkers(trace_reader_t *reader, const char *file){
+    memset(&(reader->markers), 0, sizeof(marker_filter_t));
+    reader->markers.file = file;
+    if(!reader->stream && !loadMarkers(reader)) {
+        fprintf(stderr, "Warning: No markers in %s, no record passes\n", file);
+    }
+}
+
+static bool passMarkers(trace_reader_t *reader, const trace_record_t *rec){
+    marker_filter_t *markers = &(reader->markers);
+    if(!markers->loaded) {
+        // tracegen writes the file just before its 1-byte marker store
+        if(!reader->stream || rec->op != 'S' || rec->size != 1 || !loadMarkers(reader)) {
+            return false;
+        }
+    }
+    if(markers->done) {
+        return false;
+    }
+    if(rec->addr == markers->start) {
+        markers->inside = true;
+    }
+    bool pass = markers->inside && rec->addr < MARKER_ADDR_LIMIT;
+    if(rec->addr == markers->end) {
+        markers->inside = false;
+        markers->done = true;
+    }
+    return pass;
+}
+
+static bool nextChunkRecord(trace_reader_t *reader, trace_record_t *rec){
+    chunk_parser_t *parser = reader->parser;
+    record_buffer_t *buf = parser->buffers + parser->current % parser->slots;
+    const packed_record_t *in;
+    // Workers keep instruction fetches, they are dropped here unless wanted
+    do {
+        while(!parser->acquired || parser->pos == buf->count) {
+            pthread_mutex_lock(&(parser->lock));
+            if(parser->acquired) {
+                // Done with this chunk, its slot can take a later one
+                buf->ready = false;
+                parser->acquired = false;
+                parser->current++;
+                parser->pos = 0;
+                pthread_cond_broadcast(&(parser->space));
+                buf = parser->buffers + parser->current % parser->slots;
+            }
+            if(parser->current >= parser->chunks) {
+                pthread_mutex_unlock(&(parser->lock));
+                return false;
+            }
+            while(!buf->ready) {
+                pthread_cond_wait(&(parser->ready), &(parser->lock));
+            }
+            parser->acquired = true;
+            pthread_mutex_unlock(&(parser->lock));
+        }
+        in = buf->records + parser->pos++;
+    } while(in->op == 'I' && !reader->fetches);
+    rec->op = in->op;
+    rec->addr = in->addr;
+    rec->size = in->size;
+    rec->time = in->timed ? in->time : reader->count;
+    rec->core = in->core;
+    rec->run = NULL;
+    if(in->op == 'R') {
+        // The slots do not fit the packed record, decode them again
+        bool timed;
+        parseLine(parser->data + in->text, parser->data + in->text + in->text_len, rec, &timed, &(reader->run), false);
+    }
+    size_t len = (in->text_len < BUFFER_SIZE) ? in->text_len : BUFFER_SIZE - 1;
+    memcpy(reader->buf, parser->data + in->text, len);
+    reader->buf[len] = 0;
+    reader->count += rec->run ? rec->run->count * rec->run->slots : 1;
+    return true;
+}
+
+static bool nextStreamRecord(trace_reader_t *reader, trace_record_t *rec){
+    stream_reader_t *stream = reader->stream;
+    stream_half_t *half = stream->halves + stream->current;
+    while(true) {
+        while(!stream->acquired || stream->pos == half->len) {
+            pthread_mutex_lock(&(stream->lock));
+            if(stream->acquired) {
+                // Hand the drained half back to the reading thread
+                half->full = false;
+                stream->acquired = false;
+                stream->pos = 0;
+                stream->current ^= 1;
+                pthread_cond_broadcast(&(stream->cond));
+                half = stream->halves + stream->current;
+            }
+            while(!half->full && !stream->done) {
+                pthread_cond_wait(&(stream->cond), &(stream->lock));
+            }
+            stream->acquired = half->full;
+            pthread_mutex_unlock(&(stream->lock));
+            if(!stream->acquired) {
+                return false;
+            }
+        }
+        const char *p = half->data + stream->pos, *limit = half->data + half->len;
+        const char *nl = memchr(p, '\n', limit - p);
+        const char *end = nl ? nl : limit;
+        stream->pos = (nl ? nl + 1 : limit) - half->data;
+        while(end > p && end[-1] == '\r') {
+            end--;
+        }
+        bool timed;
+        if(!parseLine(p, end, rec, &timed, &(reader->run), reader->fetches)) {
+            continue;
+        }
+        size_t len = (end - p < BUFFER_SIZE) ? end - p : BUFFER_SIZE - 1;
+        memcpy(reader->buf, p, len);
+        reader->buf[len] = 0;
+        if(!timed) {
+            rec->time = reader->count;
+        }
+        reader->count += rec->run ? rec->run->count * rec->run->slots : 1;
+        return true;
+    }
+}
+
+static bool readRecord(trace_reader_t *reader, trace_record_t *rec){
+    char *buf = reader->buf;
+    if(reader->parser) {
+        return nextChunkRecord(reader, rec);
+    }
+    if(reader->stream) {
+        return nextStreamRecord(reader, rec);
+    }
+    while((fgets(buf, sizeof(reader->buf), reader->fptr) != NULL)) {
+        // Remove new line char at the end of line
+        size_t len = strlen(buf);
+        while(len && (buf[len-1] == '\n' || buf[len-1] == '\r')) {
+            buf[--len] = 0;
+        }
+        bool timed;
+        if(!parseLine(buf, buf + len, rec, &timed, &(reader->run), reader->fetches)) {
+            continue;
+        }
+        if(!timed) {
+            rec->time = reader->count;
+        }
+        reader->count += rec->run ? rec->run->count * rec->run->slots : 1;
+        return true;
+    }
+    return false;
+}
+
+bool nextRecord(trace_reader_t *reader, trace_record_t *rec){
+    while(readRecord(reader, rec)) {
+        if(!reader->markers.file || passMarkers(reader, rec)) {
+            return true;
+        }
+        // A stream is drained so its writer does not die of SIGPIPE
+        if(reader->markers.done && !reader->stream) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void expandRun(const trace_record_t *rec, uint64_t i, trace_record_t *out, char *text){
+    const run_slot_t *slot = rec->run->slot + i % rec->run->slots;
+    out->op = slot->op;
+    out->addr = slot->addr + (uint64_t)slot->stride * (i / rec->run->slots);
+    out->size = slot->size;
+    // Untimed runs advance the record count by their length
+    out->time = rec->time + i;
+    out->core = rec->core;
+    out->run = NULL;
+    if(text) {
+        snprintf(text, BUFFER_SIZE, " %c %lx,%lu", out->op, out->addr, out->size);
+    }
+}
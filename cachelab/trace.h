@@ -0,0 +1,104 @@
+/*
+ * trace.h - Reader for valgrind lackey style memory traces
+ */
+#ifndef CSIM_TRACE_H
+#define CSIM_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Longest line read, room for a run line of RUN_MAX_SLOTS slots
+#define BUFFER_SIZE 1024
+// Interleaved streams one run line may describe, enough for the loop
+// bodies of lackey traces with their stack accesses
+#define RUN_MAX_SLOTS 16
+
+/*
+ * A run line "R 1000 L 600a00,4 +4 S 6c0a00,4 +256" stands for 1000
+ * repetitions of its slots in order, each slot moving by its stride per
+ * repetition: L 600a00, S 6c0a00, L 600a04, S 6c0b00, ... tracezip
+ * writes them, csim simulates them in bulk where it can.
+ */
+typedef struct run_slot{
+    char op;
+    uint64_t addr;
+    uint64_t size;
+    int64_t stride;
+}run_slot_t;
+
+typedef struct trace_run{
+    uint64_t count;
+    unsigned slots;
+    run_slot_t slot[RUN_MAX_SLOTS];
+}trace_run_t;
+
+/*
+ * One data access: " L 7ff000388,4" is op 'L', addr 0x7ff000388, size 4.
+ * Records may carry a decimal timestamp and a thread/core id after the
+ * size, as in " L 7ff000388,4 1200 t3". Records without a timestamp are
+ * stamped with their index in the trace, without an id they run on core 0.
+ */
+typedef struct trace_record{
+    char op;
+    uint64_t addr;
+    uint64_t size;
+    uint64_t time;
+    unsigned core;
+    // For op 'R', the run, valid until the next record is read
+    const trace_run_t *run;
+}trace_record_t;
+
+/*
+ * Keeps only the records between the accesses to the start and end marker
+ * addresses that tracegen writes to .marker, and below 4GB, as eval_perf()
+ * in test-trans.c does. A streamed trace may start before tracegen wrote
+ * the file, so it is only read once a fresh one exists.
+ */
+typedef struct marker_filter{
+    const char *file; // NULL when not filtering
+    bool loaded, inside, done;
+    uint64_t start, end;
+}marker_filter_t;
+
+struct chunk_parser;
+struct stream_reader;
+
+typedef struct trace_reader{
+    FILE *fptr;
+    // Text of the last record read, without the line ending
+    char buf[BUFFER_SIZE];
+    uint64_t count;
+    // Set when the trace is decoded by worker threads instead
+    struct chunk_parser *parser;
+    // Set for pipes and FIFOs, read ahead by a thread
+    struct stream_reader *stream;
+    marker_filter_t markers;
+    trace_run_t run;
+    // Pass instruction fetches on as op 'I' records
+    bool fetches;
+}trace_reader_t;
+
+// "-" reads stdin. Pipes and FIFOs are read by a thread into double buffers.
+bool openTrace(trace_reader_t *reader, const char *file);
+/*
+ * openTraceThreads - Open a trace decoded by threads workers. A regular
+ *                    file is mapped and split into newline-aligned chunks;
+ *                    records still come out in trace order. Falls back to
+ *                    the sequential reader for threads of 0 or other files.
+ */
+bool openTraceThreads(trace_reader_t *reader, const char *file, unsigned threads);
+void closeTrace(trace_reader_t *reader);
+// Only pass the records of the region bounded by the markers in file
+void setTraceMarkers(trace_reader_t *reader, const char *file);
+// Also read the I lines of instruction fetches, which are skipped by default
+void setTraceFetches(trace_reader_t *reader, bool fetches);
+
+// Read the next data access, skipping instruction fetches unless asked
+// for and blank lines
+bool nextRecord(trace_reader_t *reader, trace_record_t *rec);
+// Access i of the run record rec as a plain record, with its text unless
+// text is NULL
+void expandRun(const trace_record_t *rec, uint64_t i, trace_record_t *out, char *text);
+
+#endif /* CSIM_TRACE_H */
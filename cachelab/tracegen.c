@@ -5,6 +5,30 @@
  * The beginning and end of each registered transpose function's trace
  * is indicated by reading from "marker" addresses. These two marker
  * addresses are recorded in file for later use.
+ *
+ * With -T <threads>, tracegen instead writes a lackey style trace of a
+ * tiled transpose split across threads to stdout. Each record carries a
+ * t<id> field naming the thread, so csim --cores can look for coherence
+ * traffic and false sharing between them. Tiles are dealt to threads
+ * along the rows of A by default, which keeps each line of B with one
+ * thread whenever the tile rows per thread line up. -D col deals them
+ * down the tile columns of A instead, that is along the rows of B, so
+ * neighbouring tiles writing the same lines of B go to different threads.
+ *
+ * A and B live in one arena aligned to ARENA_ALIGN. -o <a>,<b> and
+ * -a <align> move them as layoutMatrices() describes; the defaults keep
+ * B 256KB after A as the old static arrays were. -p <a>,<b> pads the
+ * rows of A and B, which only the -T trace can show: the transpose
+ * functions take unpadded arrays, so test-trans pads valgrind traces
+ * by moving their addresses instead.
+ *
+ * -l adds the transposes of order.c. A function working in blocked or
+ * Morton order gets A converted before the start marker and B converted
+ * back after the end marker, so its trace is the transpose alone.
+ *
+ * -e adds the transposes of elemtrans.c for other element types. The
+ * arena is laid out for the element size of the function run with -F,
+ * or the largest one when every function runs.
  */
 
 #include <stdlib.h>
@@ -13,6 +37,8 @@
 #include <unistd.h>
 #include <getopt.h>
 #include "cachelab.h"
+#include "order.h"
+#include "elemtrans.h"
 #include <string.h>
 
 /* External variables declared in cachelab.c */
@@ -25,10 +51,19 @@ extern void registerFunctions();
 /* Markers used to bound trace regions of interest */
 volatile char MARKER_START, MARKER_END;
 
-static int A[256][256];
-static int B[256][256];
+#define ARENA_ALIGN (1 << 20)
+#define ARENA_INTS (1 << 20)
+#define MAX_PAD 256
+
+static int arena[ARENA_INTS] __attribute__((aligned(ARENA_ALIGN)));
+static int *A, *B;
 static int M;
 static int N;
+static layout_t layout = { 0, 0, DEFAULT_LAYOUT_ALIGN, 0, 0 };
+/* Row-major A and B of functions that work in another order */
+static int row_a[256 * 256], row_b[256 * 256];
+/* The transpose of A for functions of other element types */
+static elem128_t elem_c[256 * 256];
 
 
 int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
@@ -46,12 +81,114 @@ int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     return 1;
 }
 
+int validateElems(int fn, size_t size) {
+    const char *b = (const char *) B, *c = (const char *) elem_c;
+    correctTransElems(M,N,size,A,elem_c);
+    for(size_t k=0;k<(size_t)M*N;k++) {
+        if(memcmp(b+k*size,c+k*size,size)) {
+            printf("Validation failed on function %d! Wrong %lu byte element at B[%lu][%lu]\n",
+                   fn,size,k/N,k%N);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * runFunction - Run function fn between the markers on A and B stored
+ * in its order, and check that B ends up the transpose of A
+ */
+int runFunction(int fn) {
+    order_t order = func_list[fn].order;
+    if (func_list[fn].elem_func) {
+        MARKER_START = 33;
+        (*func_list[fn].elem_func)(M, N, A, B);
+        MARKER_END = 34;
+        return validateElems(fn, func_list[fn].elem_size);
+    }
+    if (order != ORDER_ROW_MAJOR) {
+        memcpy(row_a, A, sizeof(int) * M * N);
+        toOrder(order, N, M, row_a, A);
+    }
+    MARKER_START = 33;
+    (*func_list[fn].func_ptr)(M, N, (int (*)[M]) A, (int (*)[N]) B);
+    MARKER_END = 34;
+    if (order == ORDER_ROW_MAJOR)
+        return validate(fn,M,N,(int (*)[M]) A,(int (*)[N]) B);
+    fromOrder(order, M, N, B, row_b);
+    /* The next function takes A row-major again */
+    memcpy(A, row_a, sizeof(int) * M * N);
+    return validate(fn,M,N,(int (*)[M]) row_a,(int (*)[N]) row_b);
+}
+
+/* Progress of one thread through its share of the tiles */
+typedef struct {
+    int tile;   /* index of the current tile, -1 when done */
+    int i, j;   /* position inside the tile */
+} thread_pos_t;
+
+/* 
+ * emitThreadedTrace - Print the accesses of a tile x tile blocked
+ * transpose with tiles dealt cyclically to threads, numbered along the
+ * rows of A or, with by_column, down its columns. Threads advance one
+ * element per turn so their accesses interleave round robin.
+ */
+void emitThreadedTrace(int threads, int tile, int by_column) {
+    int rows = (N + tile - 1) / tile;
+    int cols = (M + tile - 1) / tile;
+    int tiles = rows * cols;
+    int active = 0;
+    int (*a)[M] = (int (*)[M]) A;
+    int (*b)[N] = (int (*)[N]) B;
+    /* Printed addresses follow the padded rows, the data stays unpadded */
+    int lda = M + layout.a_pad, ldb = N + layout.b_pad;
+    thread_pos_t pos[threads];
+
+    for (int t = 0; t < threads; t++) {
+        pos[t].tile = t < tiles ? t : -1;
+        pos[t].i = pos[t].j = 0;
+        active += pos[t].tile >= 0;
+    }
+    while (active > 0) {
+        for (int t = 0; t < threads; t++) {
+            thread_pos_t *p = &pos[t];
+            if (p->tile < 0)
+                continue;
+            int ti = by_column ? p->tile % rows : p->tile / cols;
+            int tj = by_column ? p->tile / rows : p->tile % cols;
+            int i = ti * tile + p->i;
+            int j = tj * tile + p->j;
+            if (i < N && j < M) {
+                printf(" L %llx,4 t%d\n", (unsigned long long int) (A + i * lda + j), t);
+                printf(" S %llx,4 t%d\n", (unsigned long long int) (B + j * ldb + i), t);
+                b[j][i] = a[i][j];
+            }
+            if (++p->j == tile) {
+                p->j = 0;
+                if (++p->i == tile) {
+                    p->i = 0;
+                    p->tile += threads;
+                    if (p->tile >= tiles) {
+                        p->tile = -1;
+                        active--;
+                    }
+                }
+            }
+        }
+    }
+}
+
 int main(int argc, char* argv[]){
     int i;
 
     char c;
     int selectedFunc=-1;
-    while( (c=getopt(argc,argv,"M:N:F:")) != -1){
+    int threads=0;
+    int tile=8;
+    int orders=0;
+    int elems=0;
+    int by_column=0;
+    while( (c=getopt(argc,argv,"M:N:F:T:K:D:o:a:p:le")) != -1){
         switch(c){
         case 'M':
             M = atoi(optarg);
@@ -62,6 +199,34 @@ int main(int argc, char* argv[]){
         case 'F':
             selectedFunc = atoi(optarg);
             break;
+        case 'T':
+            threads = atoi(optarg);
+            break;
+        case 'K':
+            tile = atoi(optarg);
+            break;
+        case 'D':
+            if (strcmp(optarg, "row") && strcmp(optarg, "col")) {
+                printf("./tracegen: -D deals tiles by row or col.\n");
+                exit(1);
+            }
+            by_column = !strcmp(optarg, "col");
+            break;
+        case 'o':
+            sscanf(optarg, "%lu,%lu", &layout.a_offset, &layout.b_offset);
+            break;
+        case 'a':
+            layout.align = strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            sscanf(optarg, "%d,%d", &layout.a_pad, &layout.b_pad);
+            break;
+        case 'l':
+            orders = 1;
+            break;
+        case 'e':
+            elems = 1;
+            break;
         case '?':
         default:
             printf("./tracegen failed to parse its options.\n");
@@ -72,9 +237,51 @@ int main(int argc, char* argv[]){
 
     /*  Register transpose functions */
     registerFunctions();
+    if (orders)
+        registerOrderFunctions();
+    if (elems)
+        registerElemFunctions();
+    if (selectedFunc >= func_counter) {
+        printf("./tracegen: there is no function %d.\n", selectedFunc);
+        exit(1);
+    }
+
+    /* Place A and B, which must fit the arena with their padding */
+    unsigned long a_start, b_start;
+    size_t elem_size = sizeof(int);
+    for (i=0; i < func_counter; i++) {
+        if ((selectedFunc == -1 || selectedFunc == i) && func_list[i].elem_size > elem_size)
+            elem_size = func_list[i].elem_size;
+    }
+    if (layout.align == 0 || layout.align > ARENA_ALIGN ||
+        layout.a_pad < 0 || layout.a_pad > MAX_PAD ||
+        layout.b_pad < 0 || layout.b_pad > MAX_PAD) {
+        printf("./tracegen: bad layout, align must be in 1..%d and pads in 0..%d.\n",
+               ARENA_ALIGN, MAX_PAD);
+        exit(1);
+    }
+    layoutMatrices(&layout, M, N, elem_size, &a_start, &b_start);
+    /* Morton order may need more room than row-major */
+    if (orders && (a_start + sizeof(int) * orderSize(ORDER_MORTON, N, M) > b_start ||
+                   b_start + sizeof(int) * orderSize(ORDER_MORTON, M, N) > sizeof(arena))) {
+        printf("./tracegen: layout leaves no room for Morton order.\n");
+        exit(1);
+    }
+    if (b_start + elem_size * M * (N + layout.b_pad) > sizeof(arena)) {
+        printf("./tracegen: layout does not fit the %lu byte arena.\n", sizeof(arena));
+        exit(1);
+    }
+    if (threads == 0 && (layout.a_pad || layout.b_pad)) {
+        printf("./tracegen: padding needs -T, test-trans -S pads valgrind traces.\n");
+        exit(1);
+    }
+    A = (int *)((char *)arena + a_start);
+    B = (int *)((char *)arena + b_start);
 
     /* Fill A with data */
-    initMatrix(M,N, A, B); 
+    initMatrix(M,N, (int (*)[M]) A, (int (*)[N]) B); 
+    if (elem_size > sizeof(int))
+        initMatrixElems(M, N, elem_size, A, B);
 
     /* Record marker addresses */
     FILE* marker_fp = fopen(".marker","w");
@@ -84,20 +291,33 @@ int main(int argc, char* argv[]){
             (unsigned long long int) &MARKER_END );
     fclose(marker_fp);
 
+    /* Record matrix bounds so csim can attribute misses to A and B */
+    FILE* regions_fp = fopen(".regions","w");
+    assert(regions_fp);
+    fprintf(regions_fp, "A %llx %llx\nB %llx %llx\n",
+            (unsigned long long int) A,
+            (unsigned long long int) A + elem_size * N * (M + layout.a_pad),
+            (unsigned long long int) B,
+            (unsigned long long int) B + elem_size * M * (N + layout.b_pad));
+    fclose(regions_fp);
+
+    if (threads > 0) {
+        if (tile <= 0) {
+            printf("./tracegen: tile size must be positive.\n");
+            return 1;
+        }
+        emitThreadedTrace(threads, tile, by_column);
+        return !validate(0,M,N,(int (*)[M]) A,(int (*)[N]) B);
+    }
+
     if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
         for (i=0; i < func_counter; i++) {
-            MARKER_START = 33;
-            (*func_list[i].func_ptr)(M, N, A, B);
-            MARKER_END = 34;
-            if (!validate(i,M,N,A,B))
+            if (!runFunction(i))
                 return i+1;
         }
     } else {
-        MARKER_START = 33;
-        (*func_list[selectedFunc].func_ptr)(M, N, A, B);
-        MARKER_END = 34;
-        if (!validate(selectedFunc,M,N,A,B))
+        if (!runFunction(selectedFunc))
             return selectedFunc+1;
 
     }
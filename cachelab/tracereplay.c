@@ -0,0 +1,367 @@
+/*
+ * tracereplay.c - Replay a lackey style memory trace on the host
+ *
+ * Reads a trace the way csim does (runs, markers and all) and issues
+ * its loads and stores, in order, against one mmap'ed arena. The pages
+ * the trace touches are grouped into segments; pages less than -g bytes
+ * apart share a segment and keep their relative offsets. Segments are
+ * packed into the arena with each one's start congruent to its original
+ * address modulo -A bytes, so page offsets and the cache set bits below
+ * -A stay as they were.
+ *
+ * The trace is translated to arena offsets up front and the arena is
+ * populated before timing, so the timed loop is the accesses alone. It
+ * is repeated -r times after -w untimed passes; the best and mean wall
+ * times are reported, and with -c the hardware counters of the best
+ * pass, where perf events are available.
+ */
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PAGE_LEN 12
+#define PAGE_SIZE (1UL << PAGE_LEN)
+
+/* One access, first with its trace address, then its arena offset */
+typedef struct replay_op {
+    uint64_t addr;
+    uint32_t size;
+    char op;
+} replay_op_t;
+
+typedef struct segment {
+    uint64_t base, end;   /* page aligned trace addresses */
+    uint64_t offset;      /* arena offset of base */
+} segment_t;
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} counter_events[] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "l1d-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "llc-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "dtlb-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+#define COUNTERS (sizeof(counter_events) / sizeof(counter_events[0]))
+
+static replay_op_t *ops;
+static size_t op_count, op_capacity;
+/* Loaded values end up here so the loads are not optimized away */
+static volatile uint64_t sink;
+
+static void addOp(char op, uint64_t addr, uint64_t size)
+{
+    if (op_count == op_capacity) {
+        op_capacity = op_capacity ? op_capacity * 2 : 65536;
+        ops = realloc(ops, op_capacity * sizeof(replay_op_t));
+        if (!ops) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    /* Zero-sized accesses still touch the byte at addr */
+    ops[op_count++] = (replay_op_t){ addr, size ? size : 1, op };
+}
+
+static void addRecord(const trace_record_t *rec)
+{
+    switch (rec->op) {
+    case 'L':
+    case 'S':
+        addOp(rec->op, rec->addr, rec->size);
+        break;
+    case 'M':
+        addOp('L', rec->addr, rec->size);
+        addOp('S', rec->addr, rec->size);
+        break;
+    }
+}
+
+static int compareAddr(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Group the pages the accesses touch into segments and lay them out in
+ * the arena. Returns the arena size.
+ */
+static uint64_t layoutSegments(segment_t **segments, size_t *count, uint64_t gap, uint64_t align)
+{
+    uint64_t *pages = malloc(2 * op_count * sizeof(uint64_t));
+    size_t n = 0;
+    if (!pages) {
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < op_count; i++) {
+        pages[n++] = ops[i].addr >> PAGE_LEN;
+        pages[n++] = (ops[i].addr + ops[i].size - 1) >> PAGE_LEN;
+    }
+    qsort(pages, n, sizeof(uint64_t), compareAddr);
+
+    segment_t *seg = malloc(n * sizeof(segment_t));
+    size_t used = 0;
+    if (!seg) {
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint64_t base = pages[i] << PAGE_LEN;
+        if (used && base < seg[used - 1].end + gap) {
+            seg[used - 1].end = base + PAGE_SIZE;
+            continue;
+        }
+        seg[used++] = (segment_t){ base, base + PAGE_SIZE, 0 };
+    }
+    free(pages);
+
+    uint64_t size = 0;
+    for (size_t i = 0; i < used; i++) {
+        /* Next offset at or after size with the alignment of base */
+        uint64_t offset = (size & ~(align - 1)) | (seg[i].base & (align - 1));
+        if (offset < size)
+            offset += align;
+        seg[i].offset = offset;
+        size = offset + (seg[i].end - seg[i].base);
+    }
+    *segments = seg;
+    *count = used;
+    return size;
+}
+
+/* Turn every trace address into its arena offset */
+static void translate(const segment_t *seg, size_t count)
+{
+    for (size_t i = 0; i < op_count; i++) {
+        size_t lo = 0, hi = count - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi + 1) / 2;
+            if (seg[mid].base <= ops[i].addr)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        ops[i].addr = ops[i].addr - seg[lo].base + seg[lo].offset;
+    }
+}
+
+static void replay(char *arena)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < op_count; i++) {
+        char *p = arena + ops[i].addr;
+        if (ops[i].op == 'L') {
+            switch (ops[i].size) {
+            case 1: sum += *(volatile uint8_t *)p; break;
+            case 2: sum += *(volatile uint16_t *)p; break;
+            case 4: sum += *(volatile uint32_t *)p; break;
+            case 8: sum += *(volatile uint64_t *)p; break;
+            default:
+                for (uint32_t k = 0; k < ops[i].size; k++)
+                    sum += ((volatile uint8_t *)p)[k];
+            }
+        }
+        else {
+            switch (ops[i].size) {
+            case 1: *(volatile uint8_t *)p = i; break;
+            case 2: *(volatile uint16_t *)p = i; break;
+            case 4: *(volatile uint32_t *)p = i; break;
+            case 8: *(volatile uint64_t *)p = i; break;
+            default:
+                for (uint32_t k = 0; k < ops[i].size; k++)
+                    ((volatile uint8_t *)p)[k] = i;
+            }
+        }
+    }
+    sink += sum;
+}
+
+/* Open each counter on its own. Returns false if none would open. */
+static bool openCounters(int *fds)
+{
+    bool any = false;
+    for (size_t i = 0; i < COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_events[i].type;
+        attr.config = counter_events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        any |= (fds[i] >= 0);
+    }
+    return any;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(char *name)
+{
+    printf("Usage: %s [-hc] -t <trace> [options]\n", name);
+    printf("Options:\n");
+    printf("  -t <trace>  Trace to replay (- for stdin)\n");
+    printf("  -m <file>   Only replay the region bounded by the markers in file\n");
+    printf("  -r <num>    Timed passes (default 5)\n");
+    printf("  -w <num>    Untimed warm-up passes (default 1)\n");
+    printf("  -g <bytes>  Largest gap kept inside one segment (default 1M)\n");
+    printf("  -A <bytes>  Alignment kept for each segment, a power of two (default 1M)\n");
+    printf("  -c          Report hardware counters of the best pass\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *file = NULL, *marker_file = NULL;
+    unsigned passes = 5, warmup = 1;
+    uint64_t gap = 1UL << 20, align = 1UL << 20;
+    bool counters = false;
+    char c;
+
+    while ((c = getopt(argc, argv, "hct:m:r:w:g:A:")) != -1) {
+        switch (c) {
+        case 't':
+            file = optarg;
+            break;
+        case 'm':
+            marker_file = optarg;
+            break;
+        case 'r':
+            passes = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'g':
+            gap = strtoull(optarg, NULL, 0);
+            break;
+        case 'A':
+            align = strtoull(optarg, NULL, 0);
+            break;
+        case 'c':
+            counters = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (!file || !passes || align < PAGE_SIZE || (align & (align - 1))) {
+        printf("Error: Missing or invalid argument\n");
+        usage(argv[0]);
+        exit(1);
+    }
+
+    trace_reader_t reader;
+    trace_record_t rec;
+    if (!openTrace(&reader, file)) {
+        perror(file);
+        exit(1);
+    }
+    if (marker_file)
+        setTraceMarkers(&reader, marker_file);
+    while (nextRecord(&reader, &rec)) {
+        if (!rec.run) {
+            addRecord(&rec);
+            continue;
+        }
+        for (uint64_t i = 0; i < rec.run->count * rec.run->slots; i++) {
+            trace_record_t access;
+            expandRun(&rec, i, &access, NULL);
+            addRecord(&access);
+        }
+    }
+    closeTrace(&reader);
+    if (!op_count) {
+        printf("Error: No data accesses in %s\n", file);
+        exit(1);
+    }
+
+    segment_t *segments;
+    size_t segment_count;
+    uint64_t size = layoutSegments(&segments, &segment_count, gap, align);
+    translate(segments, segment_count);
+    /* mmap only aligns to pages, map extra to align the arena itself */
+    char *mapping = mmap(NULL, size + align, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    char *arena = (char *)(((uintptr_t)mapping + align - 1) & ~(uintptr_t)(align - 1));
+    memset(arena, 1, size);
+
+    int fds[COUNTERS];
+    uint64_t values[COUNTERS] = { 0 };
+    if (counters && !openCounters(fds)) {
+        fprintf(stderr, "tracereplay: No hardware counters available\n");
+        counters = false;
+    }
+    for (unsigned i = 0; i < warmup; i++)
+        replay(arena);
+    double best = 0, total = 0;
+    for (unsigned i = 0; i < passes; i++) {
+        uint64_t pass_values[COUNTERS] = { 0 };
+        for (size_t k = 0; counters && k < COUNTERS; k++) {
+            if (fds[k] >= 0) {
+                ioctl(fds[k], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[k], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+        double start = now();
+        replay(arena);
+        double seconds = now() - start;
+        for (size_t k = 0; counters && k < COUNTERS; k++) {
+            if (fds[k] >= 0) {
+                ioctl(fds[k], PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fds[k], pass_values + k, sizeof(uint64_t)) != sizeof(uint64_t))
+                    pass_values[k] = 0;
+            }
+        }
+        if (!i || seconds < best) {
+            best = seconds;
+            memcpy(values, pass_values, sizeof(values));
+        }
+        total += seconds;
+    }
+
+    printf("replay: accesses:%lu segments:%lu arena:%luKB\n", op_count, segment_count, size >> 10);
+    printf("time: best:%.3fms mean:%.3fms per-access:%.2fns\n",
+           best * 1e3, total / passes * 1e3, best * 1e9 / op_count);
+    for (size_t k = 0; counters && k < COUNTERS; k++) {
+        if (fds[k] >= 0) {
+            printf("%s:%lu ", counter_events[k].name, values[k]);
+            close(fds[k]);
+        }
+    }
+    if (counters)
+        printf("\n");
+    munmap(mapping, size + align);
+    free(segments);
+    free(ops);
+    return 0;
+}
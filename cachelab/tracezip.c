@@ -0,0 +1,200 @@
+/*
+ * tracezip.c - Compress the strided parts of a lackey style memory trace
+ *
+ * Reads a trace from -i (default stdin) and writes it to stdout with
+ * every stretch of at least -m repetitions of 1 to RUN_MAX_SLOTS (16)
+ * accesses, each moving by a fixed stride, replaced by one run line:
+ *
+ *   R <count> <op> <addr>,<size> <stride> [<op> <addr>,<size> <stride> ...]
+ *
+ * e.g. "R 8 L 600a00,4 +4 S 6c0a00,4 +256" for a transpose row. In a
+ * lackey trace the strided accesses of a loop are interleaved with the
+ * stack accesses of its locals and counters, which become slots of
+ * stride 0, so a loop body of up to 16 accesses folds into one line. Run
+ * lines are kept within the BUFFER_SIZE of csim's trace reader. Other
+ * data accesses are copied as they are; instruction fetches are dropped
+ * since csim ignores them. Lines with a timestamp or core id, and run
+ * lines already in the input, are copied and never folded into a run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include "trace.h"
+
+#define LINE_LEN 256
+#define WINDOW 65536
+
+typedef struct access {
+    char op;
+    uint64_t addr;
+    uint64_t size;
+    char text[LINE_LEN];
+} access_t;
+
+static access_t window[WINDOW];
+static size_t head, tail;
+static uint64_t records, lines, runs;
+static int min_repeat = 4;
+
+/*
+ * Parse a plain data access " L 600a00,4". Returns 0 for lines csim
+ * skips, 1 for accesses that may join a run and 2 for lines to copy.
+ */
+static int parseAccess(const char *line, access_t *acc)
+{
+    char *end;
+    if (line[0] == 'R')
+        return 2;
+    if (line[0] != ' ' || (line[1] != 'L' && line[1] != 'S' && line[1] != 'M'))
+        return 0;
+    acc->op = line[1];
+    acc->addr = strtoull(line + 2, &end, 16);
+    if (*end != ',')
+        return 0;
+    acc->size = strtoull(end + 1, &end, 10);
+    while (*end == ' ' || *end == '\t')
+        end++;
+    return *end ? 2 : 1;
+}
+
+/* Full repetitions of the period p accesses at head within the window */
+static uint64_t repetitions(unsigned p)
+{
+    int64_t stride[RUN_MAX_SLOTS];
+    size_t i;
+    if (tail - head < 2 * p)
+        return 0;
+    for (unsigned k = 0; k < p; k++)
+        stride[k] = window[head + p + k].addr - window[head + k].addr;
+    for (i = head + p; i < tail; i++) {
+        const access_t *a = window + i, *b = window + i - p;
+        if (a->op != b->op || a->size != b->size ||
+            (int64_t)(a->addr - b->addr) != stride[(i - head) % p])
+            break;
+    }
+    return (i - head) / p;
+}
+
+static void emitPlain(const access_t *acc)
+{
+    puts(acc->text);
+    records++;
+    lines++;
+}
+
+/*
+ * Write the run line of n repetitions of the p accesses at head to line.
+ * Returns 0 if it does not fit in a BUFFER_SIZE line.
+ */
+static int formatRun(unsigned p, uint64_t n, char *line)
+{
+    size_t len = snprintf(line, BUFFER_SIZE, "R %lu", n);
+    for (unsigned k = 0; k < p && len < BUFFER_SIZE; k++) {
+        const access_t *acc = window + head + k;
+        int64_t stride = window[head + p + k].addr - acc->addr;
+        len += snprintf(line + len, BUFFER_SIZE - len, " %c %lx,%lu %c%lu", acc->op, acc->addr,
+                        acc->size, stride < 0 ? '-' : '+',
+                        stride < 0 ? -(uint64_t)stride : (uint64_t)stride);
+    }
+    return len < BUFFER_SIZE;
+}
+
+/* Encode the window from head, leaving the last keep accesses for more */
+static void encode(size_t keep)
+{
+    char line[BUFFER_SIZE], best_line[BUFFER_SIZE];
+    while (tail - head > keep) {
+        unsigned best_p = 0;
+        uint64_t best_n = 0;
+        for (unsigned p = 1; p <= RUN_MAX_SLOTS; p++) {
+            uint64_t n = repetitions(p);
+            if (n >= (uint64_t)min_repeat && n * p > best_n * best_p && formatRun(p, n, line)) {
+                best_p = p;
+                best_n = n;
+                memcpy(best_line, line, BUFFER_SIZE);
+            }
+        }
+        if (!best_n) {
+            emitPlain(window + head++);
+            continue;
+        }
+        puts(best_line);
+        head += best_n * best_p;
+        records += best_n * best_p;
+        lines++;
+        runs++;
+    }
+    /* Slide what is left to the start of the window */
+    memmove(window, window + head, (tail - head) * sizeof(access_t));
+    tail -= head;
+    head = 0;
+}
+
+static void usage(char *name)
+{
+    printf("Usage: %s [-h] [-i <trace>] [-m <num>]\n", name);
+    printf("Options:\n");
+    printf("  -i <trace>  Input trace (default stdin)\n");
+    printf("  -m <num>    Fewest repetitions worth a run line (default 4)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in = stdin;
+    char line[LINE_LEN];
+    char c;
+
+    while ((c = getopt(argc, argv, "hi:m:")) != -1) {
+        switch (c) {
+        case 'i':
+            if (!(in = fopen(optarg, "r"))) {
+                perror(optarg);
+                exit(1);
+            }
+            break;
+        case 'm':
+            min_repeat = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (min_repeat < 2) {
+        printf("Error: A run needs at least 2 repetitions\n");
+        usage(argv[0]);
+        exit(1);
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        size_t len = strlen(line);
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = 0;
+        access_t *acc = window + tail;
+        switch (parseAccess(line, acc)) {
+        case 1:
+            memcpy(acc->text, line, len + 1);
+            if (++tail == WINDOW)
+                encode(WINDOW / 2);
+            break;
+        case 2:
+            /* Keep the order of everything before the copied line */
+            encode(0);
+            puts(line);
+            records++;
+            lines++;
+            break;
+        }
+    }
+    encode(0);
+    fprintf(stderr, "tracezip: %lu records in %lu lines, %lu runs\n", records, lines, runs);
+    if (in != stdin)
+        fclose(in);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * victim.c - Victim cache and miss cache models
+ *
+ * Both sit behind the main cache and are looked up on its misses. A
+ * victim cache receives the lines the main cache evicts; a hit moves the
+ * line back and the line it displaces takes its place (swap on hit). A
+ * miss cache keeps a copy of each fetched line instead, so it only helps
+ * when a line returns soon after its fetch. The main cache counters are
+ * left alone, the buffer reports the misses it would have absorbed.
+ */
+#include "victim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool initVictimBuffer(vbuffer_t *vb, vbuffer_kind_t kind, unsigned entries){
+    memset(vb, 0, sizeof(vbuffer_t));
+    vb->kind = kind;
+    vb->entries = entries;
+    if(!(vb->tags = calloc(entries, sizeof(uint64_t))) ||
+       !(vb->last_use = calloc(entries, sizeof(uint64_t)))) {
+        perror("Error: ");
+        return false;
+    }
+    return true;
+}
+
+void freeVictimBuffer(vbuffer_t *vb){
+    free(vb->tags);
+    free(vb->last_use);
+    vb->tags = vb->last_use = NULL;
+}
+
+static int findEntry(const vbuffer_t *vb, uint64_t tag){
+    for(unsigned i = 0; i < vb->used; i++) {
+        if(vb->tags[i] == tag) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void removeEntry(vbuffer_t *vb, unsigned i){
+    vb->used--;
+    vb->tags[i] = vb->tags[vb->used];
+    vb->last_use[i] = vb->last_use[vb->used];
+}
+
+static void insertEntry(vbuffer_t *vb, uint64_t tag){
+    int i = findEntry(vb, tag);
+    if(i < 0) {
+        if(vb->used < vb->entries) {
+            i = (int)vb->used++;
+        }
+        else {
+            i = 0;
+            for(unsigned j = 1; j < vb->used; j++) {
+                if(vb->last_use[j] < vb->last_use[i]) {
+                    i = (int)j;
+                }
+            }
+        }
+    }
+    vb->tags[i] = tag;
+    vb->last_use[i] = ++(vb->now);
+}
+
+bool recordVictimBuffer(vbuffer_t *vb, const cache_t *cache, uint64_t addr, const result_t *ret){
+    if(!ret->miss) {
+        return false;
+    }
+    uint64_t tag = getTag(cache, addr);
+    int i = findEntry(vb, tag);
+    vb->lookups++;
+    if(i >= 0) {
+        vb->absorbed++;
+    }
+    if(vb->kind == VB_VICTIM) {
+        // The line moves back to the main cache, its victim moves here
+        if(i >= 0) {
+            removeEntry(vb, (unsigned)i);
+        }
+        if(ret->eviction) {
+            insertEntry(vb, ret->victim.tag);
+        }
+    }
+    else {
+        insertEntry(vb, tag);
+    }
+    return i >= 0;
+}
+
+void printVictimBufferStats(const vbuffer_t *vb){
+    printf("%s: entries:%u lookups:%lu absorbed:%lu (%.1f%%) misses-after:%lu\n",
+           vb->kind == VB_VICTIM ? "victim-cache" : "miss-cache", vb->entries, vb->lookups,
+           vb->absorbed, vb->lookups ? 100.0 * vb->absorbed / vb->lookups : 0,
+           vb->lookups - vb->absorbed);
+}
@@ -0,0 +1,34 @@
+/*
+ * victim.h - Small fully-associative victim cache or miss cache behind
+ *            the main cache
+ */
+#ifndef CSIM_VICTIM_H
+#define CSIM_VICTIM_H
+
+#include "cache.h"
+
+typedef enum vbuffer_kind{
+    VB_VICTIM,  // Holds lines evicted from the main cache, swaps on a hit
+    VB_MISS     // Holds a copy of every line the main cache fetched
+}vbuffer_kind_t;
+
+typedef struct vbuffer{
+    vbuffer_kind_t kind;
+    unsigned entries, used;
+    // Block number and last use of each entry, LRU replacement
+    uint64_t *tags;
+    uint64_t *last_use;
+    uint64_t now;
+    // Main cache misses looked up, and those the buffer held
+    uint64_t lookups, absorbed;
+}vbuffer_t;
+
+bool initVictimBuffer(vbuffer_t *vb, vbuffer_kind_t kind, unsigned entries);
+void freeVictimBuffer(vbuffer_t *vb);
+
+// Update the buffer after an access to the main cache returned ret.
+// Returns true if the buffer held the line of a main cache miss.
+bool recordVictimBuffer(vbuffer_t *vb, const cache_t *cache, uint64_t addr, const result_t *ret);
+void printVictimBufferStats(const vbuffer_t *vb);
+
+#endif /* CSIM_VICTIM_H */